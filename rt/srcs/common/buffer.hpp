@@ -1,5 +1,7 @@
 #pragma once
+#include <bitset>
 #include <cstddef>
+#include <cstring>
 #include <string>
 #include "traits.hpp"
 #include "types.hpp"
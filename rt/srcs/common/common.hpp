@@ -15,6 +15,7 @@
 #include "raw_io.hpp"
 #include "buffer.hpp"
 #include "return.hpp"
+#include "metrics.hpp"
 #include "error_prefix.hpp"
 
 namespace common {
@@ -44,26 +45,30 @@ inline void reset_metrics() noexcept {
     stdout_contended.store(0, std::memory_order_relaxed);
     stderr_failed.store(0, std::memory_order_relaxed);
     stdout_failed.store(0, std::memory_order_relaxed);
+    MetricsRegistry::reset();
 }
 inline void flush_metrics_dump() noexcept {
     const auto sc = val(stderr_contended);
     const auto so = val(stdout_contended);
     const auto sf = val(stderr_failed);
     const auto fo = val(stdout_failed);
-    if ((sc | so | sf | fo) == 0) [[likely]] {
+    const auto rm = MetricsRegistry::snapshot();
+    if ((sc | so | sf | fo) == 0 && !any_metrics(rm)) [[likely]] {
         sv_t msg{"\nMETRICS DUMP: Metrics have no changes.\n"};
         raw_write_stderr(msg.data(), msg.size());
         return;
     }
-    RawBuffer<512>
+    RawBuffer<1024>
     buf(
         "\nMETRICS DUMP ===============\n",
         "stderr_contended: ", to_sv(sc), '\n',
         "stdout_contended: ", to_sv(so), '\n',
         "stderr_failed:    ", to_sv(sf), '\n',
-        "stdout_failed:    ", to_sv(fo), '\n',
-        "METRICS DUMP END ===========\n"
+        "stdout_failed:    ", to_sv(fo), '\n'
         );
+    if (any_metrics(rm))
+        append_render_metrics(buf.append("Render:\n"), rm);
+    buf.append("METRICS DUMP END ===========\n");
     buf.finalize_ellipsis_newline(true);
     raw_write_stderr(buf.data(), buf.size());
     reset_metrics();
@@ -1,4 +1,5 @@
 #pragma once
+#include <charconv>
 #include <cstddef>
 #include <utility>
 #include "types.hpp"
@@ -41,7 +42,7 @@ namespace common {
     return b ? "true" : "false";
 }
 
-[[nodiscard]] inline constexpr int parse_int(sv_t sv, int fback = 0) noexcept {
+[[nodiscard]] inline int parse_int(sv_t sv, int fback = 0) noexcept {
     int value = fback;
     auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value);
     return (ec == std::errc{}) ? value : fback;
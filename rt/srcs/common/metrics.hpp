@@ -0,0 +1,210 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <filesystem>
+#include <mutex>
+#include "types.hpp"
+#include "buffer.hpp"
+#include "return.hpp"
+
+// Renderer work counters, reported by --metrics-dump and --metrics-file.
+// Each thread increments its own cache-line aligned block without atomic
+// read-modify-write; the blocks are summed when the metrics are read.
+// The rt_ renderer counts into this registry (rt_/srcs/Metrics.hpp) and
+// reports it with the same options.
+
+namespace common {
+
+enum class Metric : uint8_t {
+    PrimaryRays,
+    ShadowRays,
+    SecondaryRays,
+    PhotonRays,
+    IntersectionTests,
+    BvhNodesVisited,
+    PhotonLookups,
+    Samples,
+    Passes,
+    PassTimeNs,
+    count_
+};
+
+inline constexpr size_t kMetricCount = static_cast<size_t>(Metric::count_);
+
+inline constexpr std::array<sv_t, kMetricCount> kMetricNames{
+    "primary_rays",
+    "shadow_rays",
+    "secondary_rays",
+    "photon_rays",
+    "intersection_tests",
+    "bvh_nodes_visited",
+    "photon_lookups",
+    "samples",
+    "passes",
+    "pass_time_ns",
+};
+
+[[nodiscard]] inline constexpr sv_t as_sv(Metric m) noexcept {
+    return m < Metric::count_ ? kMetricNames[static_cast<size_t>(m)] : "unknown";
+}
+
+using MetricValues = std::array<uint64_t, kMetricCount>;
+
+struct alignas(64) MetricCounters {
+    std::array<std::atomic<uint64_t>, kMetricCount> values{};
+
+    void add(Metric m, uint64_t n) noexcept {
+        auto& v = values[static_cast<size_t>(m)];
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+class MetricsRegistry {
+public:
+    [[nodiscard]] static MetricCounters& local() noexcept {
+        thread_local MetricCounters* counters = instance().add();
+        return *counters;
+    }
+
+    [[nodiscard]] static MetricValues snapshot() noexcept {
+        MetricValues sum{};
+        auto& r = instance();
+        std::lock_guard lk(r.mtx_);
+        for (const auto& c : r.threads_)
+            for (size_t i = 0; i < kMetricCount; ++i)
+                sum[i] += c.values[i].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // Call while the counting threads are idle
+    static void reset() noexcept {
+        auto& r = instance();
+        std::lock_guard lk(r.mtx_);
+        for (auto& c : r.threads_)
+            for (auto& v : c.values)
+                v.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::mutex                 mtx_;
+    std::deque<MetricCounters> threads_;
+
+    // Never destroyed: the global rt::Config reports it from its destructor
+    [[nodiscard]] static MetricsRegistry& instance() noexcept {
+        static MetricsRegistry* registry = new MetricsRegistry;
+        return *registry;
+    }
+
+    MetricCounters* add() noexcept {
+        std::lock_guard lk(mtx_);
+        return &threads_.emplace_back();
+    }
+};
+
+inline void metric_add(Metric m, uint64_t n = 1) noexcept {
+    MetricsRegistry::local().add(m, n);
+}
+
+// Adds one pass and its duration when leaving the scope
+class PassMetric {
+public:
+    PassMetric() noexcept : start_(std::chrono::steady_clock::now()) {}
+    ~PassMetric() noexcept {
+        using namespace std::chrono;
+        const auto ns = duration_cast<nanoseconds>(steady_clock::now() - start_);
+        metric_add(Metric::Passes);
+        metric_add(Metric::PassTimeNs, static_cast<uint64_t>(ns.count()));
+    }
+    PassMetric(const PassMetric&) = delete;
+    PassMetric& operator=(const PassMetric&) = delete;
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+[[nodiscard]] inline bool any_metrics(const MetricValues& v) noexcept {
+    for (uint64_t x : v) if (x) return true;
+    return false;
+}
+
+[[nodiscard]] inline uint64_t rays_total(const MetricValues& v) noexcept {
+    using enum Metric;
+    const auto at = [&](Metric m) { return v[static_cast<size_t>(m)]; };
+    return at(PrimaryRays) + at(ShadowRays) + at(SecondaryRays) + at(PhotonRays);
+}
+
+// Rays per second of pass time, 0 without timed passes
+[[nodiscard]] inline uint64_t rays_per_second(const MetricValues& v) noexcept {
+    const uint64_t ns = v[static_cast<size_t>(Metric::PassTimeNs)];
+    if (ns == 0) return 0;
+    return static_cast<uint64_t>(static_cast<double>(rays_total(v)) * 1e9 /
+                                 static_cast<double>(ns));
+}
+
+template<size_t N>
+RawBuffer<N>& append_render_metrics(RawBuffer<N>& buf, const MetricValues& v) noexcept {
+    for (size_t i = 0; i < kMetricCount; ++i) {
+        buf.append(kMetricNames[i]);
+        buf.append(": ");
+        buf.append(to_sv(v[i]));
+        buf.append('\n');
+    }
+    buf.append("rays_per_second: ");
+    buf.append(to_sv(rays_per_second(v)));
+    buf.append('\n');
+    return buf;
+}
+
+inline os_t& write_metrics_text(os_t& os, const MetricValues& v) {
+    for (size_t i = 0; i < kMetricCount; ++i)
+        os << kMetricNames[i] << ": " << v[i] << '\n';
+    return os << "rays_per_second: " << rays_per_second(v) << '\n';
+}
+
+inline os_t& write_metrics_json(os_t& os, const MetricValues& v) {
+    os << "{\n";
+    for (size_t i = 0; i < kMetricCount; ++i)
+        os << "  \"" << kMetricNames[i] << "\": " << v[i] << ",\n";
+    return os << "  \"rays_per_second\": " << rays_per_second(v) << "\n}\n";
+}
+
+inline os_t& write_metrics_csv_header(os_t& os) {
+    for (size_t i = 0; i < kMetricCount; ++i)
+        os << kMetricNames[i] << ',';
+    return os << "rays_per_second\n";
+}
+
+inline os_t& write_metrics_csv_row(os_t& os, const MetricValues& v) {
+    for (size_t i = 0; i < kMetricCount; ++i)
+        os << v[i] << ',';
+    return os << rays_per_second(v) << '\n';
+}
+
+// '.json' overwrites the file; any other extension is CSV, one row per
+// run appended under a single header, to compare runs and builds.
+[[nodiscard]] inline Return save_metrics(sv_t path) noexcept {
+    namespace fs = std::filesystem;
+    const MetricValues v = MetricsRegistry::snapshot();
+    try {
+        const fs::path p{path};
+        const bool json = p.extension() == ".json";
+        std::error_code ec;
+        const bool header = !json && (!fs::exists(p, ec) || fs::file_size(p, ec) == 0);
+        std::ofstream out(p, json ? std::ios::trunc : std::ios::app);
+        if (!out) return error("Failed to open metrics file", path);
+        if (json) write_metrics_json(out, v);
+        else {
+            if (header) write_metrics_csv_header(out);
+            write_metrics_csv_row(out, v);
+        }
+        if (!out.good()) return error("Failed to write metrics file", path);
+    } catch (...) {
+        return error("Failed to write metrics file", path);
+    }
+    return ok();
+}
+
+} // namespace common
@@ -30,7 +30,7 @@ inline os_t& operator<<(os_t& os, const Return& ret) { return ret.write(os); }
 Return error(sv_t status, sv_t prompt = {}, bool fatal = false) noexcept {
 #if !defined(NDEBUG)
         if (status.empty()) status = "CODING ERROR (missing error status)";
-#elif
+#else
         if (status.empty()) status = "Unknown error";
 #endif
     return {status, prompt, fatal};
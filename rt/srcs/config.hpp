@@ -38,12 +38,14 @@ Flags:
   --no-utf8           Disable UTF-8 output, fallback to ASCII
   --no-emoji          Disable emoji in output
   --no-warns          Disable deferred logger warnings
+  --log-async         Log through a background writer thread
   --config-dump       Write config dump - !defined(NDEBUG) only
   --metrics-dump      Write metrics dump - !defined(NDEBUG) only
 Parameters:
   --config=path       Path to the another user defined config file
-  --log-out=target    Logging output (stdout, stderr, file)
+  --log-out=target    Logging output (stdout, stderr, file, binary)
   --log-file=path     Path to log file
+  --metrics-file=path Save render metrics on exit (.json, else CSV row)
   --test-string=value Test string value
   --test-param=N      Test numeric parameter
 
@@ -66,6 +68,7 @@ struct Config {
     bool    emoji_allowed = true;
     bool    warns_allowed = true;
     Output  log_out       = Output::Stderr;
+    bool    log_async     = false;
     Buff32  log_file      = default_log_file;
     mutable LogWarns log_warns;
 
@@ -73,11 +76,15 @@ struct Config {
     Buff512 config_file  = default_config_file;
     bool    config_dump  = false;
     bool    metrics_dump = false;
+    Buff512 metrics_file{};
     int     test_param   = 0;
     Buff512 test_string{};
     // ...
 
     ~Config() noexcept {
+        if (!metrics_file.empty())
+            (void)common::report_error("Error saving metrics:",
+                                       common::save_metrics(metrics_file.view()));
         if constexpr (debug_mode) {
             using namespace common;
             if (config_dump) flush_config_dump();
@@ -141,12 +148,14 @@ struct Config {
             "  emoji_allowed:  ", emoji_allowed,  '\n',
             "  warns_allowed:  ", warns_allowed,  '\n',
             "  log_out:        ", log_out,        '\n',
+            "  log_async:      ", log_async,      '\n',
             "  log_file:       '",log_file,      "'\n",
             "  log_warns:      ", std::bitset<8>(log_warns.bits()),'\n',
             "Common:\n",
             "  config_file:    '",config_file,   "'\n",
             "  config_dump:    ", config_dump,    '\n',
             "  metrics_dump:   ", metrics_dump,   '\n',
+            "  metrics_file:   '",metrics_file,  "'\n",
             "  test_param:     ", test_param,     '\n',
             "  test_string:    '",test_string,   "'\n",
             "CONFIG DUMP END ============\n"
@@ -264,6 +273,7 @@ private:
             case hash_31("no-utf8"):      utf8_inited   = false; break;
             case hash_31("no-emoji"):     emoji_allowed = false; break;
             case hash_31("no-warns"):     warns_allowed = false; break;
+            case hash_31("log-async"):    log_async     = true;  break;
             case hash_31("config-dump"):  config_dump   = true;  break;
             case hash_31("metrics-dump"): metrics_dump  = true;  break;
             default: return error("Unrecognized flag", sv_arg, true);
@@ -300,10 +310,15 @@ private:
                                                     Output::CreateDirs |
                                                     Output::Indexing |
                                                     Output::TimeIndex;
+                else if (val == "binary") log_out = Output::Binary |
+                                                    Output::CreateDirs |
+                                                    Output::Indexing |
+                                                    Output::TimeIndex;
                 else return error("Invalid value for log-out", val, true);
                 break;
             }
             case hash_31("log-file"):    return log_file.set(val,key).fatal_on();
+            case hash_31("metrics-file"): return metrics_file.set(val,key).fatal_on();
             case hash_31("test-string"): return test_string.set(val,key).fatal_on();
             case hash_31("test-param"):  test_param = parse_int(val); break;
             case hash_31("config"):      break;// parsed in config_path()
@@ -0,0 +1,217 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "../common/common.hpp"
+
+namespace logging {
+
+using sv_t = std::string_view;
+
+inline constexpr size_t kRecordSize    = 512;        // bytes of one ring cell
+inline constexpr size_t kRingRecords   = 128;        // cells per thread, power of two
+inline constexpr size_t kBatchSize     = 16 * 1024;  // bytes gathered into one write()
+inline constexpr auto   kDrainInterval = std::chrono::milliseconds{5};
+
+static_assert((kRingRecords & (kRingRecords - 1)) == 0,
+              "kRingRecords must be a power of two");
+
+using Record   = common::RawBuffer<kRecordSize>;
+using write_fn = std::function<bool(sv_t)>;
+
+// Single-producer single-consumer ring of pre-formatted records.
+// The producer is the thread owning the LoggerSink, the consumer is the
+// AsyncWriter (always under its mutex). A message longer than one cell takes
+// several consecutive cells; when the ring has no room for all of them the
+// whole message is dropped and counted, so memory stays bounded.
+class RecordRing {
+public:
+    explicit RecordRing(write_fn write) noexcept
+        : write_(std::move(write)) {}
+
+    RecordRing(const RecordRing&) = delete;
+    RecordRing& operator=(const RecordRing&) = delete;
+
+    [[nodiscard]] bool push(sv_t sv) noexcept {
+        const size_t cap  = Record::capacity();
+        const size_t n    = (sv.size() + cap - 1) / cap;
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        if (n == 0) return true;
+        if (failed() || tail - head + n > kRingRecords) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        for (size_t i = 0; i < n; ++i)
+            cells_[(tail + i) & kMask] = common::safe_substr(sv, i * cap, cap);
+        tail_.store(tail + n, std::memory_order_release);
+        return true;
+    }
+
+    // Moves every published record into 'batch', writing the batch out
+    // whenever the next record does not fit. Consumer side only.
+    template<size_t N>
+    void drain(common::RawBuffer<N>& batch) noexcept {
+        static_assert(N > kRecordSize, "Batch smaller than a record");
+        size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        if (head == tail) return;
+        batch.reset();
+        for (; head != tail; ++head) {
+            const Record& rec = cells_[head & kMask];
+            if (batch.remaining() < rec.size()) {
+                write(batch.view());
+                batch.reset();
+            }
+            batch.append(rec);
+            head_.store(head + 1, std::memory_order_release);
+        }
+        write(batch.view());
+        batch.reset();
+    }
+
+    [[nodiscard]] size_t size() const noexcept {
+        return tail_.load(std::memory_order_acquire) -
+               head_.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] uint64_t dropped() const noexcept {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool failed() const noexcept {
+        return failed_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr size_t kMask = kRingRecords - 1;
+
+    std::unique_ptr<Record[]> cells_{new Record[kRingRecords]};
+    write_fn                  write_;
+    alignas(64) std::atomic<size_t>   head_{0};
+    alignas(64) std::atomic<size_t>   tail_{0};
+    alignas(64) std::atomic<uint64_t> dropped_{0};
+    std::atomic<bool>                 failed_{false};
+
+    void write(sv_t sv) noexcept {
+        if (sv.empty() || failed()) return;
+        bool ok = false;
+        try { ok = write_(sv); } catch (...) { ok = false; }
+        if (!ok) failed_.store(true, std::memory_order_relaxed);
+    }
+};
+
+// Background thread draining the rings of all async LoggerSinks.
+// Producers never take its mutex: they publish into their own ring and
+// signal the first record after the writer went idle. The writer then
+// gathers records for kDrainInterval, or less when a ring is half full,
+// drains every ring and sleeps again until the next signal, so an idle
+// logger costs no wake-ups. Rings are attached and detached under the
+// mutex, a detached ring is drained first. The writer is a function-local
+// static built by the LoggerSink constructor, before any sink can use it,
+// so it outlives every sink, static ones included, and its destructor
+// flushes whatever is left on normal and std::exit() shutdown.
+class AsyncWriter {
+public:
+    [[nodiscard]] static AsyncWriter& instance() noexcept {
+        static AsyncWriter writer;
+        return writer;
+    }
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    ~AsyncWriter() noexcept { stop(); }
+
+    [[nodiscard]] bool attach(RecordRing& ring) noexcept {
+        try {
+            std::lock_guard lk(mtx_);
+            if (stop_) return false;
+            if (!thread_.joinable())
+                thread_ = std::thread(&AsyncWriter::run, this);
+            rings_.push_back(&ring);
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    void detach(RecordRing& ring) noexcept {
+        std::lock_guard lk(mtx_);
+        ring.drain(batch_);
+        std::erase(rings_, &ring);
+    }
+
+    void flush() noexcept {
+        std::lock_guard lk(mtx_);
+        drain_all();
+    }
+
+    // Called by a producer after each push. The fence orders the published
+    // record before the load, against the fence of run() after its reset:
+    // either the producer sees the writer idle or the writer sees the record.
+    void signal() noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (pending_.load(std::memory_order_relaxed) == 0 &&
+            pending_.exchange(1, std::memory_order_relaxed) == 0)
+            pending_.notify_one();
+    }
+
+    // Ends the gathering interval early
+    void wake_up() noexcept { cv_.notify_one(); }
+
+    void stop() noexcept {
+        {
+            std::lock_guard lk(mtx_);
+            if (stop_) return;
+            stop_ = true;
+        }
+        pending_.store(1, std::memory_order_relaxed);
+        pending_.notify_one();
+        cv_.notify_one();
+        if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id())
+            thread_.join();
+        std::lock_guard lk(mtx_);
+        drain_all();
+        rings_.clear();
+    }
+
+private:
+    std::mutex                 mtx_;
+    std::condition_variable    cv_;
+    std::vector<RecordRing*>   rings_;
+    std::thread                thread_;
+    common::RawBuffer<kBatchSize> batch_;
+    bool                       stop_ = false;
+    std::atomic<uint32_t>      pending_{0};   // a record arrived since the last drain
+
+    AsyncWriter() = default;
+
+    void drain_all() noexcept {
+        for (RecordRing* ring : rings_)
+            ring->drain(batch_);
+    }
+
+    void run() noexcept {
+        std::unique_lock lk(mtx_);
+        while (!stop_) {
+            lk.unlock();
+            pending_.wait(0, std::memory_order_relaxed);
+            lk.lock();
+            if (!stop_)
+                cv_.wait_for(lk, kDrainInterval);
+            pending_.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            drain_all();
+        }
+    }
+};
+
+} // namespace logging
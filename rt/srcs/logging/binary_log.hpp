@@ -0,0 +1,293 @@
+#pragma once
+#include <atomic>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include "../common/common.hpp"
+
+// Binary log channel (io::Output::Binary).
+//
+// The file starts with kBinaryMagic, then holds a sequence of records:
+//   u8 kind, u16 payload size, payload
+// Def payload: u32 format id, format text
+// Msg payload: u8 level, u32 thread, u64 time_ns, u32 format id, u8 nargs,
+//              then per argument a u8 ArgType tag and its raw value
+//              (Str: u16 length and bytes).
+// Values are stored in host byte order. A format text is written once per
+// file, before the first message that uses it, so the file is decoded
+// without the program that wrote it (see tools/decode_log.cpp).
+// Each '{}' in a format text stands for the next argument.
+
+namespace logging {
+
+using sv_t = std::string_view;
+
+inline constexpr sv_t   kBinaryMagic      = {"RTBLOG\0\1", 8};
+inline constexpr size_t kBinaryRecordSize = 512;
+inline constexpr sv_t   kPlaceholder      = "{}";
+
+enum class RecordKind : uint8_t { Def = 1, Msg = 2 };
+
+enum class ArgType : uint8_t { Int, Uint, Float, Bool, Char, Str };
+
+// Process-wide table of format texts. Id 0 is the plain text format used
+// for messages logged with msg() into a binary sink.
+class FormatCatalog {
+public:
+    [[nodiscard]] static uint32_t id(sv_t text) noexcept {
+        auto& c = instance();
+        std::lock_guard lk(c.mtx_);
+        try {
+            c.texts_.push_back(text);
+        } catch (...) {
+            return 0;
+        }
+        c.size_.store(static_cast<uint32_t>(c.texts_.size()),
+                      std::memory_order_release);
+        return static_cast<uint32_t>(c.texts_.size() - 1);
+    }
+
+    [[nodiscard]] static sv_t text(uint32_t id) noexcept {
+        auto& c = instance();
+        std::lock_guard lk(c.mtx_);
+        return id < c.texts_.size() ? c.texts_[id] : sv_t{};
+    }
+
+    [[nodiscard]] static uint32_t size() noexcept {
+        return instance().size_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::mutex            mtx_;
+    std::deque<sv_t>      texts_{kPlaceholder};
+    std::atomic<uint32_t> size_{1};
+
+    [[nodiscard]] static FormatCatalog& instance() noexcept {
+        static FormatCatalog catalog;
+        return catalog;
+    }
+};
+
+// Small stable index of the calling thread, cheaper to store than thread::id
+[[nodiscard]] inline uint32_t thread_index() noexcept {
+    static std::atomic<uint32_t> next{0};
+    thread_local const uint32_t index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+// One encoded record. Unlike RawBuffer it holds raw bytes (NUL included)
+// and never truncates a value: an argument that does not fit is left out.
+struct BinaryRecord {
+    [[nodiscard]] sv_t view() const noexcept { return {data_, len_}; }
+    [[nodiscard]] size_t size() const noexcept { return len_; }
+    [[nodiscard]] size_t remaining() const noexcept { return kBinaryRecordSize - len_; }
+
+    BinaryRecord& reset() noexcept { len_ = 0; return *this; }
+
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    bool put(const T& v) noexcept {
+        if (remaining() < sizeof(T)) return false;
+        std::memcpy(data_ + len_, &v, sizeof(T));
+        len_ += sizeof(T);
+        return true;
+    }
+
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    void put_at(size_t pos, const T& v) noexcept {
+        assert(pos + sizeof(T) <= len_);
+        std::memcpy(data_ + pos, &v, sizeof(T));
+    }
+
+    bool put_bytes(sv_t sv) noexcept {
+        if (remaining() < sv.size()) return false;
+        std::memcpy(data_ + len_, sv.data(), sv.size());
+        len_ += sv.size();
+        return true;
+    }
+
+    bool put_str(sv_t sv) noexcept {
+        if (remaining() < sizeof(uint16_t)) return false;
+        const size_t room = std::min(remaining() - sizeof(uint16_t), size_t{UINT16_MAX});
+        sv = common::safe_substr(sv, 0, room);
+        return put(static_cast<uint16_t>(sv.size())) && put_bytes(sv);
+    }
+
+    template<typename T>
+    bool put_arg(const T& x) noexcept {
+        using U = std::remove_cvref_t<T>;
+        const size_t rollback = len_;
+        bool ok = false;
+        if constexpr (std::is_same_v<U, bool>) {
+            ok = put(ArgType::Bool) && put(static_cast<uint8_t>(x));
+        } else if constexpr (std::is_same_v<U, char>) {
+            ok = put(ArgType::Char) && put(x);
+        } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+            ok = put(ArgType::Int) && put(static_cast<int64_t>(x));
+        } else if constexpr (std::is_integral_v<U> || std::is_enum_v<U>) {
+            ok = put(ArgType::Uint) && put(static_cast<uint64_t>(x));
+        } else if constexpr (std::is_floating_point_v<U>) {
+            ok = put(ArgType::Float) && put(static_cast<double>(x));
+        } else if constexpr (std::is_convertible_v<const U&, sv_t>) {
+            ok = put(ArgType::Str) && put_str(sv_t{x});
+        } else {
+            try {
+                auto& oss = common::tl_buffer<struct binary_record_tag>();
+                oss << x;
+                ok = put(ArgType::Str) && put_str(oss.view());
+            } catch (...) {
+                ok = false;
+            }
+        }
+        if (!ok) len_ = rollback;
+        return ok;
+    }
+
+private:
+    char   data_[kBinaryRecordSize];
+    size_t len_ = 0;
+};
+
+[[nodiscard]] inline uint64_t now_ns() noexcept {
+    using namespace std::chrono;
+    return static_cast<uint64_t>(
+        duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count());
+}
+
+inline constexpr size_t kRecordHeader = sizeof(uint8_t) + sizeof(uint16_t);
+
+template<typename Tag = struct tl_default_tag>
+[[nodiscard]] inline BinaryRecord& tl_binary_record() noexcept {
+    thread_local BinaryRecord rec{};
+    return rec.reset();
+}
+
+inline void finish_record(BinaryRecord& rec) noexcept {
+    rec.put_at(sizeof(uint8_t), static_cast<uint16_t>(rec.size() - kRecordHeader));
+}
+
+inline BinaryRecord& encode_def(BinaryRecord& rec, uint32_t fmt_id) noexcept {
+    rec.reset();
+    rec.put(RecordKind::Def);
+    rec.put(uint16_t{0});
+    rec.put(fmt_id);
+    const sv_t text = FormatCatalog::text(fmt_id);
+    rec.put_bytes(common::safe_substr(text, 0, rec.remaining()));
+    finish_record(rec);
+    return rec;
+}
+
+template<typename Level, typename... Args>
+BinaryRecord& encode_msg(BinaryRecord& rec, Level lvl, uint32_t fmt_id,
+                                            const Args&... args) noexcept {
+    static_assert(sizeof...(Args) <= UINT8_MAX, "Too many arguments");
+    rec.reset();
+    rec.put(RecordKind::Msg);
+    rec.put(uint16_t{0});
+    rec.put(static_cast<uint8_t>(lvl));
+    rec.put(thread_index());
+    rec.put(now_ns());
+    rec.put(fmt_id);
+    const size_t nargs_at = rec.size();
+    rec.put(uint8_t{0});
+    uint8_t nargs = 0;
+    bool fits = true;
+    if constexpr (sizeof...(Args) > 0)
+        ((fits = fits && rec.put_arg(args) && ++nargs), ...);
+    rec.put_at(nargs_at, nargs);
+    finish_record(rec);
+    return rec;
+}
+
+// Decoding, used by the offline tool and by sinks that are not binary
+
+struct DecodedMsg {
+    uint8_t  level   = 0;
+    uint32_t thread  = 0;
+    uint64_t time_ns = 0;
+    uint32_t fmt_id  = 0;
+    sv_t     args{};      // raw encoded arguments
+    uint8_t  nargs   = 0;
+};
+
+class RecordReader {
+public:
+    explicit RecordReader(sv_t bytes) noexcept : p_(bytes) {}
+
+    template<typename T> requires std::is_trivially_copyable_v<T>
+    [[nodiscard]] bool get(T& v) noexcept {
+        if (p_.size() < sizeof(T)) return false;
+        std::memcpy(&v, p_.data(), sizeof(T));
+        p_.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    [[nodiscard]] bool get(sv_t& sv, size_t n) noexcept {
+        if (p_.size() < n) return false;
+        sv = p_.substr(0, n);
+        p_.remove_prefix(n);
+        return true;
+    }
+
+    [[nodiscard]] sv_t rest() const noexcept { return p_; }
+    [[nodiscard]] bool empty() const noexcept { return p_.empty(); }
+
+    // Writes the next argument as text, false at the end or on bad data
+    [[nodiscard]] bool write_arg(common::os_t& os) {
+        ArgType type{};
+        if (!get(type)) return false;
+        switch (type) {
+            case ArgType::Int:   { int64_t  v; if (!get(v)) return false; os << v; break; }
+            case ArgType::Uint:  { uint64_t v; if (!get(v)) return false; os << v; break; }
+            case ArgType::Float: { double   v; if (!get(v)) return false; os << v; break; }
+            case ArgType::Bool:  { uint8_t  v; if (!get(v)) return false; os << (v != 0); break; }
+            case ArgType::Char:  { char     v; if (!get(v)) return false; os << v; break; }
+            case ArgType::Str:   {
+                uint16_t n; sv_t sv;
+                if (!get(n) || !get(sv, n)) return false;
+                os << sv;
+                break;
+            }
+            default: return false;
+        }
+        return true;
+    }
+
+private:
+    sv_t p_;
+};
+
+[[nodiscard]] inline std::optional<DecodedMsg> decode_msg(sv_t payload) noexcept {
+    RecordReader r(payload);
+    DecodedMsg m;
+    if (!r.get(m.level) || !r.get(m.thread) || !r.get(m.time_ns) ||
+        !r.get(m.fmt_id) || !r.get(m.nargs))
+        return std::nullopt;
+    m.args = r.rest();
+    return m;
+}
+
+// Substitutes the arguments for the '{}' of 'fmt'; arguments left over
+// (plain text messages, id 0) are appended.
+inline common::os_t& write_text(common::os_t& os, sv_t fmt, const DecodedMsg& m) {
+    RecordReader r(m.args);
+    uint8_t left = m.nargs;
+    for (size_t pos = 0; ; ) {
+        const size_t at = fmt.find(kPlaceholder, pos);
+        os << common::safe_substr(fmt, pos, at == sv_t::npos ? sv_t::npos : at - pos);
+        if (at == sv_t::npos) break;
+        if (left) {
+            if (!r.write_arg(os)) return os;
+            --left;
+        }
+        pos = at + kPlaceholder.size();
+    }
+    while (left-- && r.write_arg(os)) {}
+    return os;
+}
+
+} // namespace logging
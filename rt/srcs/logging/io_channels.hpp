@@ -23,7 +23,7 @@ using os_t    = std::ostream;
 using sv_t    = std::string_view;
 using ofs_t   = std::ofstream;
 using ifs_t   = std::ifstream;
-using flags_t = uint8_t;
+using flags_t = uint16_t;
 namespace fs  = std::filesystem;
 
 enum class Output : flags_t {
@@ -31,14 +31,16 @@ enum class Output : flags_t {
     Stderr     = 0b0010'0000,
     File       = 0b0100'0000,
     Buffer     = 0b1000'0000,
+    Binary     = 0b1'0000'0000, // file of compact records, see binary_log.hpp
 
     Append     = 0b0000'0001,
     Indexing   = 0b0000'0010,
     TimeIndex  = 0b0000'0100,
-    CreateDirs = 0b0000'1000
+    CreateDirs = 0b0000'1000,
+    Async      = 0b0001'0000
 };
 
-constexpr Output ChannelMask = static_cast<Output>(0b1110'0000);
+constexpr Output ChannelMask = static_cast<Output>(0b1'1110'0000);
 constexpr Output PolicyMask  = static_cast<Output>(0b0001'1111);
 
 [[nodiscard]]
@@ -69,15 +71,23 @@ inline constexpr Output operator&(Output a, Output b) noexcept {
 }
 
 [[nodiscard]] inline constexpr bool is_stderr(Output v) noexcept {
-    return has_flag(v, Output::Stderr);
+    return channel_of(v) == Output::Stderr;
 }
 
 [[nodiscard]] inline constexpr bool is_file(Output v) noexcept {
-    return has_flag(v, Output::File);
+    return channel_of(v) == Output::File;
 }
 
 [[nodiscard]] inline constexpr bool is_buffer(Output v) noexcept {
-    return has_flag(v, Output::Buffer);
+    return channel_of(v) == Output::Buffer;
+}
+
+[[nodiscard]] inline constexpr bool is_binary(Output v) noexcept {
+    return channel_of(v) == Output::Binary;
+}
+
+[[nodiscard]] inline constexpr bool is_file_backed(Output v) noexcept {
+    return is_file(v) || is_binary(v);
 }
 
 [[nodiscard]] inline constexpr bool has_single_channel(Output v) noexcept {
@@ -92,7 +102,7 @@ inline constexpr Output operator&(Output a, Output b) noexcept {
 [[nodiscard]] inline sv_t as_sv(Output v) noexcept {
     thread_local common::RawBuffer<64> buf{};
     buf.reset();
-    if (is_file(v)) {                        buf.append("File");
+    if (is_file_backed(v)) {                 buf.append(is_binary(v) ? "Binary" : "File");
         if (has_flag(v, Output::Append))     buf.append("|Append");
         if (has_flag(v, Output::Indexing))   buf.append("|Indexing");
         if (has_flag(v, Output::TimeIndex))  buf.append("|TimeIndex");
@@ -101,6 +111,7 @@ inline constexpr Output operator&(Output a, Output b) noexcept {
     } else if (is_buffer(v)) {               buf.append("Buffer");
     } else {                                 buf.append("Stdout");
     }
+    if (has_flag(v, Output::Async))          buf.append("|Async");
     buf.finalize_ellipsis_newline(false);
     return buf.view();
 }
@@ -182,7 +193,7 @@ on_collision(const fs::path& base_with_ts, const fs::path& ext)  {
 [[nodiscard]] inline std::optional<fs::path>
 prepare_output_file_path(const fs::path& path,
                          Output mode = Output::File) noexcept {
-    if (!is_file(mode)) return std::nullopt;
+    if (!is_file_backed(mode)) return std::nullopt;
     try {
         fs::path dir  = path.parent_path();
         fs::path base = path.stem();
@@ -258,12 +269,14 @@ common::Return open_output_file(ofs_t& out, sv_t raw_path,
                                           Output mode = Output::File) noexcept {
     using namespace logging;
     using namespace common;
-    if (!has_flag(mode, Output::File))
+    if (!is_file_backed(mode))
         return error("Output mode does not target a file", {}, true);
     auto path = prepare_output_file_path(raw_path, mode);
     if (!path)
         return error("Invalid or inaccessible file path", raw_path, true);
     auto flags = std::ios::out;
+    if (is_binary(mode))
+        flags |= std::ios::binary;
     if (has_flag(mode, Output::Append))
         flags |= std::ios::app;
     else
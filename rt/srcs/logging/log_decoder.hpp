@@ -0,0 +1,66 @@
+#pragma once
+#include <ctime>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include "logger.hpp"
+
+// Decoding of a binary log (log-out=binary) into the logger's text format,
+// used by tools/decode_log.cpp. The text is what a text sink of channel
+// 'mode' would have received: a message is not given a newline it lacked.
+
+namespace logging {
+
+inline void write_stamp(os_t& os, const DecodedMsg& m) {
+    const auto secs = static_cast<std::time_t>(m.time_ns / 1'000'000'000);
+    const auto usec = static_cast<unsigned>(m.time_ns / 1'000 % 1'000'000);
+    std::tm tm{};
+    localtime_r(&secs, &tm);
+    char buf[48];
+    const size_t n = std::strftime(buf, sizeof(buf), "%H:%M:%S", &tm);
+    os << sv_t{buf, n} << '.' << std::setw(6) << std::setfill('0') << usec
+       << std::setfill(' ') << " #" << m.thread << ' ';
+}
+
+// Writes the records up to the first truncated or corrupt one, which is
+// reported as an error.
+[[nodiscard]] inline common::Return
+decode_binary_log(sv_t bytes, os_t& os, bool stamps = false,
+                  io::Output mode = io::Output::Stdout) {
+    using namespace common;
+    std::vector<std::string> formats;
+    RecordReader r(bytes);
+    sv_t magic;
+    if (!r.get(magic, kBinaryMagic.size()) || magic != kBinaryMagic)
+        return error("Not a binary log");
+    while (!r.empty()) {
+        RecordKind kind{};
+        uint16_t   size = 0;
+        sv_t       payload;
+        if (!r.get(kind) || !r.get(size) || !r.get(payload, size))
+            return error("Truncated record");
+        if (kind == RecordKind::Def) {
+            RecordReader def(payload);
+            uint32_t id = 0;
+            if (!def.get(id)) return error("Corrupt record");
+            if (formats.size() <= id) formats.resize(id + 1);
+            formats[id] = def.rest();
+            continue;
+        }
+        const auto m = decode_msg(payload);
+        if (kind != RecordKind::Msg || !m)
+            return error("Corrupt record");
+        const auto lvl = static_cast<Level>(m->level);
+        const sv_t fmt = m->fmt_id < formats.size() ? sv_t{formats[m->fmt_id]}
+                                                     : kPlaceholder;
+        auto& fmt_lvl = sticker_format(lvl);
+        oss_t text;
+        if (stamps) write_stamp(text, *m);
+        write_text(text, fmt, *m);
+        fmt_lvl.apply(mode, os, sticker(lvl, fmt_lvl.should_emoji()));
+        fmt_lvl.apply(mode, os, text.view());
+    }
+    return ok();
+}
+
+} // namespace logging
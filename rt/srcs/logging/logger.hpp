@@ -17,6 +17,12 @@
     logging::make_global_logger().msg(logging::Level::Time __VA_OPT__(, ) __VA_ARGS__); } while(0)
 #define ok_msg(...) do { \
     logging::make_global_logger().msg(logging::Level::Ok __VA_OPT__(, ) __VA_ARGS__); } while(0)
+// Telemetry: bin_msg(Time, "tile {} done in {} us\n", tile, us);
+// The format is a string literal registered once per call site; each '{}'
+// takes the next argument. A binary sink stores the raw arguments only.
+#define bin_msg(level, fmt, ...) do { \
+    static const uint32_t bin_fmt_id_ = logging::FormatCatalog::id(fmt); \
+    logging::make_global_logger().bin(logging::Level::level, bin_fmt_id_ __VA_OPT__(, ) __VA_ARGS__); } while(0)
 
 namespace logging {
 
@@ -123,6 +129,14 @@ protected:
 
     io::Output mode() const noexcept { return sink_.get_mode(); }
 
+    bool is_async() const noexcept { return sink_.is_async(); }
+
+    bool push(sv_t record) noexcept { return sink_.push(record); }
+
+    bool async_failed() const noexcept { return is_async() && !sink_.good(); }
+
+    bool is_binary() const noexcept { return sink_.is_binary(); }
+
     void on_write_failure(bool failed) {
         sink_.on_write_failure(failed);
     }
@@ -142,8 +156,18 @@ struct GlobalLogger : LoggerBase {
         msg(level, sticker_format(level), args...);
     }
 
+    template<typename... Args>
+    void bin(Level lvl, uint32_t fmt_id, const Args&... args) noexcept {
+        auto& rec = encode_msg(tl_binary_record(), lvl, fmt_id, args...);
+        if (!is_binary()) return bin_text_msg(lvl, fmt_id, rec.view());
+        (void)sink_.write_binary(fmt_id, rec.view());
+        on_write_failure(!sink_.good());
+    }
+
     template<traits::Ostreamable... Args>
     void msg(Level lvl, const Format& args_fmt, const Args&... args) noexcept {
+        if (is_binary()) return binary_msg(lvl, args_fmt, args...);
+        if (is_async()) return async_msg(lvl, args_fmt, args...);
         bool ok = out().good();
         if (ok) {
             try {
@@ -161,6 +185,55 @@ struct GlobalLogger : LoggerBase {
         }
         on_write_failure(!ok);
     }
+
+private:
+    // Formats the whole message on the calling thread, then hands it over
+    // to the sink's ring: no lock and no I/O on the hot path.
+    template<traits::Ostreamable... Args>
+    void async_msg(Level lvl, const Format& args_fmt, const Args&... args) noexcept {
+        try {
+            auto& oss             = common::tl_buffer<struct async_msg_tag>();
+            auto& sticker_fmt     = sticker_format(lvl);
+            const auto sticker_sv = sticker(lvl, sticker_fmt.should_emoji());
+            sticker_fmt.apply(mode(), oss, sticker_sv);
+            if constexpr (sizeof...(Args) > 0)
+                args_fmt.apply(mode(), oss, args...);
+            (void)push(oss.view());
+        } catch (...) {
+            rt::config.log_warns.set(Warn::LoggingBufferFailed);
+        }
+        on_write_failure(async_failed());
+    }
+
+    // Text message into a binary sink: one string argument of format 0
+    template<traits::Ostreamable... Args>
+    void binary_msg(Level lvl, const Format& args_fmt, const Args&... args) noexcept {
+        try {
+            auto& oss = common::tl_buffer<struct binary_msg_tag>();
+            Format text_fmt{ args_fmt };
+            text_fmt.control.end_policy = Format::Control::EndPolicy::None;
+            if constexpr (sizeof...(Args) > 0)
+                text_fmt.apply(mode(), oss, args...);
+            auto& rec = encode_msg(tl_binary_record(), lvl, 0, oss.view());
+            (void)sink_.write_binary(0, rec.view());
+        } catch (...) {
+            rt::config.log_warns.set(Warn::LoggingBufferFailed);
+        }
+        on_write_failure(!sink_.good());
+    }
+
+    // Telemetry into a text sink is decoded right away
+    void bin_text_msg(Level lvl, uint32_t fmt_id, sv_t record) noexcept {
+        const auto m = decode_msg(common::safe_substr(record, kRecordHeader));
+        if (!m) return;
+        try {
+            auto& oss = common::tl_buffer<struct bin_text_msg_tag>();
+            write_text(oss, FormatCatalog::text(fmt_id), *m);
+            msg(lvl, oss.view());
+        } catch (...) {
+            rt::config.log_warns.set(Warn::LoggingBufferFailed);
+        }
+    }
 };
 
 // Returns a global debug logger.
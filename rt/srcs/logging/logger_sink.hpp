@@ -1,5 +1,7 @@
 #pragma once
 #include "../config.hpp"
+#include "async_sink.hpp"
+#include "binary_log.hpp"
 #include <string_view>
 #include <ostream>
 #include <sstream>
@@ -19,11 +21,13 @@ struct LoggerSink {
 
     explicit LoggerSink(io::Output mode, sv_t raw_path = {},
                                        bool fatal_on_failure = false) noexcept {
+        (void)AsyncWriter::instance();   // built first, destroyed after this sink
         init(mode, raw_path, fatal_on_failure);
     }
 
     ~LoggerSink() noexcept {
         using namespace rt;
+        stop_async();
         cfg().flush_log_warns();
         close_file();
     }
@@ -32,14 +36,18 @@ struct LoggerSink {
     LoggerSink& operator=(const LoggerSink&) = delete;
     
     LoggerSink& init_default() noexcept {
-        return init(cfg().log_out, cfg().log_file.view(), true);
+        const io::Output mode = cfg().log_async ? cfg().log_out | io::Output::Async
+                                                : cfg().log_out;
+        return init(mode, cfg().log_file.view(), true);
     }
 
     LoggerSink& init(io::Output mode, sv_t raw_path = {},
                                        bool fatal_on_failure = false) noexcept {
         using namespace common;
+        stop_async();
         close_file();
         mode_ = mode;
+        defined_ = 0;
         raw_path_ = raw_path;
         fatal_on_failure_ = fatal_on_failure;
         if (const auto ret = setup_output_stream(); !ret.ok()) {
@@ -48,6 +56,40 @@ struct LoggerSink {
                 cfg().flush_log_warns();
                 fatal_exit(ExitCode::LoggingFailure);
             }
+        } else if (io::has_flag(mode_, io::Output::Async) && !is_buffered()) {
+            start_async();
+        }
+        return *this;
+    }
+
+    // Async mode: queues a pre-formatted record for the AsyncWriter thread.
+    // Never blocks; a record that does not fit in the ring is dropped.
+    bool push(sv_t record) noexcept {
+        assert(ring_ && "Internal error: push() requires async mode");
+        const size_t before = ring_->size();
+        if (!ring_->push(record)) return false;
+        auto& writer = AsyncWriter::instance();
+        writer.signal();
+        if (before < kRingRecords / 2 && ring_->size() >= kRingRecords / 2)
+            writer.wake_up();
+        return true;
+    }
+
+    // Binary mode: writes 'record' preceded by the format texts the file
+    // does not hold yet. False when the record was dropped or not written.
+    bool write_binary(uint32_t fmt_id, sv_t record) noexcept {
+        for (; defined_ <= fmt_id; ++defined_)
+            if (!write_raw(encode_def(tl_binary_record<struct def_tag>(), defined_).view()))
+                return false;
+        return write_raw(record);
+    }
+
+    LoggerSink& flush() noexcept {
+        if (is_async()) {
+            AsyncWriter::instance().flush();
+        } else if (out_) {
+            try { out() << std::flush; }
+            catch (...) { on_write_failure(true); }
         }
         return *this;
     }
@@ -85,15 +127,21 @@ struct LoggerSink {
         return view_buffer().empty();
     }
 
+    [[nodiscard]] bool is_binary() const noexcept {
+        return (mode_ & io::ChannelMask) == io::Output::Binary;
+    }
+
     [[nodiscard]] bool file_is_open() const noexcept {
-        return (mode_ & io::ChannelMask) == io::Output::File &&
-                file_.is_open();
+        return io::is_file_backed(mode_) && file_.is_open();
     }
 
     [[nodiscard]] bool good() const noexcept {
+        if (is_async()) return !ring_->failed();
         return out_ && out().good();
     }
 
+    [[nodiscard]] bool is_async() const noexcept { return ring_ != nullptr; }
+
     [[nodiscard]] io::Output get_mode() const noexcept { return mode_; }
 
 private:
@@ -106,6 +154,8 @@ private:
     ofs_t       file_;
     oss_t       buff_;
     bool        fatal_on_failure_ = false;
+    uint32_t    defined_ = 0;  // format texts already in the binary file
+    std::unique_ptr<RecordRing> ring_;
     
     [[nodiscard]] const rt::Config& cfg() const noexcept {
         assert(cfg_ && "Internal error: cfg_ should never be null");
@@ -152,11 +202,64 @@ private:
             }
             return st;
         }
+        if ((mode_ & io::ChannelMask) == io::Output::Binary) {
+            const Return st = open_output_file(file_, raw_path_, mode_);
+            if (st.ok()) {
+                out_ = &file_;
+                file_.exceptions(std::ios::badbit | std::ios::failbit);
+                if (!write_raw(kBinaryMagic))
+                    return error("Failed to write binary log header", raw_path_);
+            }
+            return st;
+        }
         return error("Unrecognized or unsupported output mode");
     }
 
+    // The ring is drained by the AsyncWriter thread straight into out(),
+    // one batch per write, under the same mutex the synchronous path takes.
+    void start_async() noexcept {
+        try {
+            ring_ = std::make_unique<RecordRing>([this](sv_t batch) {
+                if (!out_) return false;
+                lock_t lk(mtx());
+                out().write(batch.data(), static_cast<std::streamsize>(batch.size()));
+                out() << std::flush;
+                return out().good();
+            });
+        } catch (...) {
+            ring_.reset();
+            return;
+        }
+        if (!AsyncWriter::instance().attach(*ring_))
+            ring_.reset();
+    }
+
+    bool write_raw(sv_t bytes) noexcept {
+        if (is_async()) return push(bytes);
+        if (!out_) return false;
+        try {
+            lock_t lk(mtx());
+            out().write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+            out() << std::flush;
+            return out().good();
+        } catch (...) {
+            return false;
+        }
+    }
+
+    void stop_async() noexcept {
+        if (!ring_) return;
+        AsyncWriter::instance().detach(*ring_);
+        if (ring_->dropped())
+            cfg().log_warns.set(Warn::LoggerRecordsDropped);
+        if (ring_->failed())
+            cfg().log_warns.set(Warn::LoggerWriteFailed);
+        ring_.reset();
+    }
+
     void on_write_failure(bool failed) noexcept {
         if (!failed) return;
+        stop_async();
         cfg().log_warns.set(Warn::LoggerWriteFailed);
         out_ = nullptr;
         if (fatal_on_failure_) {
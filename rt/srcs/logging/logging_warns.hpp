@@ -18,6 +18,7 @@ enum class Warn : flags_t {
     LoggingBufferFailed    = 1u << 2,
     LoggerWriteFailed      = 1u << 3,
     LoggerFileCloseFailed  = 1u << 4,
+    LoggerRecordsDropped   = 1u << 5,
 };
 
 struct LogWarnDescriptor {
@@ -52,6 +53,11 @@ constexpr LogWarnDescriptor log_warn_descriptions[] = {
         "LoggerSink failed to close output file stream. "
         "Exception suppressed."
     },
+    {
+        Warn::LoggerRecordsDropped,
+        "LoggerSink async ring overflowed. "
+        "Some log records were dropped."
+    },
 };
 
 inline constexpr Warn operator|(Warn a, Warn b) noexcept {
@@ -0,0 +1,304 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "timing.hpp"
+
+// Hierarchical scoped profiler.
+//
+//   void trace_pass() {
+//       profile_function();
+//       for (...) { profile_scope("tile"); ... }
+//   }
+//
+// Scopes are recorded only when compiled with -DRT_PROFILE; otherwise
+// profile_scope() and profile_function() expand to nothing. Each thread
+// writes complete events (label, begin, end, depth) into its own ring, with
+// no locks and no allocations; the oldest events are overwritten when a
+// ring is full. Rings live until the end of the program, so threads may
+// exit before the export. Statistics are kept per scope path: a label
+// seen under two different parents gives two entries. Export while the
+// profiled threads are idle:
+//   logging::Profiler::write_stats(std::cout);
+//   logging::Profiler::write_chrome_trace(file);  // chrome://tracing, Perfetto
+
+#if defined(RT_PROFILE)
+# define RT_PROFILE_CONCAT_(a, b) a##b
+# define RT_PROFILE_CONCAT(a, b)  RT_PROFILE_CONCAT_(a, b)
+# define profile_scope(label) \
+    const logging::ProfileScope RT_PROFILE_CONCAT(profile_scope_, __LINE__){label}
+# define profile_function() profile_scope(__func__)
+#else
+# define profile_scope(label)
+# define profile_function()
+#endif
+
+namespace logging {
+
+inline constexpr size_t kProfileEvents = 1 << 14;   // per thread, power of two
+inline constexpr sv_t   kOpenScope     = "(open)";  // ancestor not ended yet
+
+struct ProfileEvent {
+    sv_t     label;
+    uint64_t begin_ns = 0;   // since Profiler::epoch()
+    uint64_t end_ns   = 0;
+    uint32_t depth    = 0;   // number of enclosing scopes
+};
+
+struct ProfileStats {
+    std::vector<sv_t> path;  // enclosing scopes of the thread, then the label
+    sv_t     label;
+    uint32_t depth = 0;      // number of enclosing scopes
+    uint64_t count = 0;
+    uint64_t total = 0;      // ns
+    uint64_t min   = 0;
+    uint64_t max   = 0;
+    uint64_t p50   = 0;
+    uint64_t p99   = 0;
+};
+
+// Single-writer ring of one thread; readers load 'written_' with acquire
+// and see every event published before it.
+class ThreadProfile {
+public:
+    explicit ThreadProfile(uint32_t tid) noexcept : tid_(tid) {}
+
+    void record(sv_t label, uint64_t begin_ns, uint64_t end_ns, uint32_t depth) noexcept {
+        const uint64_t n = written_.load(std::memory_order_relaxed);
+        events_[n & (kProfileEvents - 1)] = {label, begin_ns, end_ns, depth};
+        written_.store(n + 1, std::memory_order_release);
+    }
+
+    template<typename F>
+    void for_each(F&& f) const {
+        const uint64_t n     = written_.load(std::memory_order_acquire);
+        const uint64_t first = n > kProfileEvents ? n - kProfileEvents : 0;
+        for (uint64_t i = first; i < n; ++i)
+            f(events_[i & (kProfileEvents - 1)]);
+    }
+
+    // Latest event first
+    template<typename F>
+    void for_each_backward(F&& f) const {
+        const uint64_t n     = written_.load(std::memory_order_acquire);
+        const uint64_t first = n > kProfileEvents ? n - kProfileEvents : 0;
+        for (uint64_t i = n; i-- > first;)
+            f(events_[i & (kProfileEvents - 1)]);
+    }
+
+    [[nodiscard]] uint32_t tid() const noexcept { return tid_; }
+
+    [[nodiscard]] uint64_t overwritten() const noexcept {
+        const uint64_t n = written_.load(std::memory_order_acquire);
+        return n > kProfileEvents ? n - kProfileEvents : 0;
+    }
+
+    uint32_t depth = 0;      // open scopes of the owning thread
+
+private:
+    std::unique_ptr<ProfileEvent[]> events_{new ProfileEvent[kProfileEvents]};
+    std::atomic<uint64_t>           written_{0};
+    uint32_t                        tid_;
+};
+
+class Profiler {
+public:
+    [[nodiscard]] static time_point_t epoch() noexcept {
+        static const time_point_t t0 = clock_t::now();
+        return t0;
+    }
+
+    [[nodiscard]] static uint64_t now_ns() noexcept {
+        using namespace std::chrono;
+        return static_cast<uint64_t>(
+            duration_cast<nanoseconds>(clock_t::now() - epoch()).count());
+    }
+
+    // Ring of the calling thread, registered on first use
+    [[nodiscard]] static ThreadProfile& local() noexcept {
+        thread_local ThreadProfile* profile = instance().add();
+        return *profile;
+    }
+
+    // In tree order: every scope path after its parent, siblings by
+    // decreasing total time
+    [[nodiscard]] static std::vector<ProfileStats> stats() {
+        std::map<std::vector<sv_t>, std::vector<uint64_t>> scopes;
+        for_each_scope([&](const std::vector<sv_t>& path, const ProfileEvent& e) {
+            scopes[path].push_back(e.end_ns - e.begin_ns);
+        });
+        std::vector<ProfileStats> out;
+        std::map<std::vector<sv_t>, uint64_t> totals;
+        out.reserve(scopes.size());
+        for (auto& [path, d] : scopes) {
+            std::sort(d.begin(), d.end());
+            ProfileStats s{ .path = path, .label = path.back(),
+                            .depth = static_cast<uint32_t>(path.size() - 1),
+                            .count = d.size() };
+            for (uint64_t ns : d) s.total += ns;
+            s.min = d.front();
+            s.max = d.back();
+            s.p50 = percentile(d, 50);
+            s.p99 = percentile(d, 99);
+            totals[path] = s.total;
+            out.push_back(std::move(s));
+        }
+        // (UINT64_MAX - total, label) of the path and of each of its ancestors
+        using key_t = std::vector<std::pair<uint64_t, sv_t>>;
+        std::vector<std::pair<key_t, size_t>> order;
+        order.reserve(out.size());
+        for (size_t i = 0; i < out.size(); ++i) {
+            key_t key;
+            std::vector<sv_t> prefix;
+            for (sv_t label : out[i].path) {
+                prefix.push_back(label);
+                const auto it = totals.find(prefix);
+                key.emplace_back(UINT64_MAX - (it != totals.end() ? it->second : 0), label);
+            }
+            order.emplace_back(std::move(key), i);
+        }
+        std::sort(order.begin(), order.end());
+        std::vector<ProfileStats> sorted;
+        sorted.reserve(out.size());
+        for (const auto& [key, i] : order) sorted.push_back(std::move(out[i]));
+        return sorted;
+    }
+
+    // Nearest-rank percentile of sorted samples: the smallest sample that
+    // at least p percent of the samples do not exceed
+    [[nodiscard]] static uint64_t percentile(const std::vector<uint64_t>& sorted,
+                                             unsigned p) noexcept {
+        const size_t rank = (sorted.size() * p + 99) / 100;   // ceil(p * n / 100)
+        return sorted[rank > 0 ? rank - 1 : 0];
+    }
+
+    static os_t& write_stats(os_t& os) {
+        using std::chrono::duration_cast;
+        const auto us = [](uint64_t ns) {
+            return duration_cast<microsec_t>(std::chrono::nanoseconds{ns});
+        };
+        for (const auto& s : stats()) {
+            for (uint32_t i = 0; i < s.depth; ++i) os << "  ";
+            os << s.label << ": count " << s.count << ", total ";
+            write_duration(os, us(s.total))   << ", min ";
+            write_duration(os, us(s.min))     << ", max ";
+            write_duration(os, us(s.max))     << ", p50 ";
+            write_duration(os, us(s.p50))     << ", p99 ";
+            write_duration(os, us(s.p99))     << '\n';
+        }
+        if (const uint64_t lost = overwritten(); lost > 0)
+            os << "(" << lost << " oldest scopes overwritten)\n";
+        return os;
+    }
+
+    // Chrome trace-event JSON, one complete ("X") event per scope
+    static os_t& write_chrome_trace(os_t& os) {
+        bool first = true;
+        os << "{\"traceEvents\":[\n";
+        for_each_event([&](const ThreadProfile& t, const ProfileEvent& e) {
+            os << (first ? "" : ",\n") << "{\"name\":\"";
+            write_json_string(os, e.label);
+            os << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t.tid()
+               << ",\"ts\":"  << e.begin_ns / 1000 << '.' << e.begin_ns % 1000 / 100
+               << ",\"dur\":" << (e.end_ns - e.begin_ns) / 1000 << '.'
+                              << (e.end_ns - e.begin_ns) % 1000 / 100 << '}';
+            first = false;
+        });
+        return os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+
+    [[nodiscard]] static uint64_t overwritten() noexcept {
+        uint64_t lost = 0;
+        auto& p = instance();
+        std::lock_guard lk(p.mtx_);
+        for (const auto& t : p.threads_) lost += t.overwritten();
+        return lost;
+    }
+
+private:
+    std::mutex                mtx_;
+    std::deque<ThreadProfile> threads_;
+
+    [[nodiscard]] static Profiler& instance() noexcept {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    ThreadProfile* add() noexcept {
+        (void)epoch();
+        std::lock_guard lk(mtx_);
+        return &threads_.emplace_back(static_cast<uint32_t>(threads_.size()));
+    }
+
+    template<typename F>
+    static void for_each_event(F&& f) {
+        auto& p = instance();
+        std::lock_guard lk(p.mtx_);
+        for (const auto& t : p.threads_)
+            t.for_each([&](const ProfileEvent& e) { f(t, e); });
+    }
+
+    // Calls f(path, event) for every scope, the path being the labels of the
+    // enclosing scopes of the same thread, outermost first, then its own.
+    // A thread records its scopes as they end, so walking them backwards
+    // meets every scope before the scopes it encloses.
+    template<typename F>
+    static void for_each_scope(F&& f) {
+        auto& p = instance();
+        std::lock_guard lk(p.mtx_);
+        std::vector<ProfileEvent> outer;    // latest scope met at each depth
+        std::vector<sv_t>         path;
+        for (const auto& t : p.threads_) {
+            outer.clear();
+            t.for_each_backward([&](const ProfileEvent& e) {
+                if (outer.size() <= e.depth) outer.resize(e.depth + 1);
+                outer[e.depth] = e;
+                path.clear();
+                for (uint32_t d = 0; d < e.depth; ++d) {
+                    const auto& o = outer[d];
+                    const bool encloses = o.begin_ns <= e.begin_ns && e.end_ns <= o.end_ns;
+                    path.push_back(encloses ? o.label : kOpenScope);
+                }
+                path.push_back(e.label);
+                f(path, e);
+            });
+        }
+    }
+
+    static void write_json_string(os_t& os, sv_t sv) {
+        for (char c : sv) {
+            if (c == '"' || c == '\\') os << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20) os << ' ';
+            else os << c;
+        }
+    }
+};
+
+// Records the time between its construction and destruction
+class ProfileScope {
+public:
+    explicit ProfileScope(sv_t label) noexcept
+    : profile_(Profiler::local()), label_(label), depth_(profile_.depth++),
+      begin_ns_(Profiler::now_ns()) {}
+
+    ~ProfileScope() noexcept {
+        profile_.record(label_, begin_ns_, Profiler::now_ns(), depth_);
+        --profile_.depth;
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    ThreadProfile& profile_;
+    sv_t           label_;
+    uint32_t       depth_;
+    uint64_t       begin_ns_;
+};
+
+} // namespace logging
@@ -0,0 +1,34 @@
+#include <fstream>
+#include <iterator>
+#include <string>
+#include "../srcs/logging/log_decoder.hpp"
+
+
+// Decodes a binary log (log-out=binary) into the logger's text format.
+// g++ -std=c++2a -O2 -Wall -Wextra -Werror ../srcs/globals.cpp decode_log.cpp -o decode_log
+// ./decode_log [--stamps] logs/rt_Y-m-d_H.M.S.log
+int main(int ac, char** av) {
+    using namespace logging;
+    bool stamps = false;
+    const char* path = nullptr;
+    for (int i = 1; i < ac; ++i) {
+        if (sv_t{av[i]} == "--stamps") stamps = true;
+        else path = av[i];
+    }
+    if (!path) {
+        std::cerr << "Usage: decode_log [--stamps] binary_log_file\n";
+        return 1;
+    }
+    rt::config.detect_environment();
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open '" << path << "'\n";
+        return 1;
+    }
+    const std::string bytes{std::istreambuf_iterator<char>(in), {}};
+    if (const auto ret = decode_binary_log(bytes, std::cout, stamps); !ret.ok()) {
+        std::cerr << ret << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -5,6 +5,7 @@
 //#include "../srcs/common/common.hpp"
 //#include "../srcs/common/common_utils.hpp"
 //#include "../srcs/common/error_prefix.hpp"
+//#include "../srcs/common/metrics.hpp"
 //#include "../srcs/common/raw_io.hpp"
 //#include "../srcs/common/return.hpp"
 //#include "../srcs/common/traits.hpp"
@@ -0,0 +1,81 @@
+#include <atomic>
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../srcs/logging/logger_sink.hpp"
+
+
+// Command lines fo testing
+// g++ -std=c++2a -O2 -Wall -Wextra -Werror ../../srcs/globals.cpp test_async_sink.cpp -o async_sink
+// ./async_sink
+using namespace logging;
+
+// Records of one thread reach its file when the sink shuts down
+static void write_thread_file(int i) {
+    const auto name = common::RawBuffer<64>("logs/async_sink_", i, ".log");
+    std::filesystem::remove(name.view());
+    {
+        LoggerSink sink(io::Output::File | io::Output::CreateDirs |
+                        io::Output::Async, name.view());
+        assert(sink.is_async());
+        for (int j = 0; j < 10; ++j) {
+            const bool pushed = sink.push(common::RawBuffer<64>("LoggerSink: Async thread #",
+                                                                i, " record #", j, '\n').view());
+            assert(pushed);
+            (void)pushed;
+        }
+    }
+    std::ifstream in{std::string(name.view())};
+    int lines = 0;
+    for (std::string line; std::getline(in, line); ++lines)
+        assert(line == common::RawBuffer<64>("LoggerSink: Async thread #",
+                                             i, " record #", lines).view());
+    assert(lines == 10);
+}
+
+int main(int ac, char** av) {
+    rt::config.init(ac, av);
+
+    // Test 1: Rings under capacity, drained by the single writer thread
+    std::atomic<size_t> drained{0};
+    const auto count = [&drained](sv_t batch) { drained += batch.size(); return true; };
+    const sv_t record = "LoggerSink: Async record\n";
+
+    RecordRing ring(count);
+    const bool attached = AsyncWriter::instance().attach(ring);
+    assert(attached);
+    size_t accepted = 0;
+    for (size_t i = 0; i < kRingRecords / 4; ++i)
+        accepted += ring.push(record);
+    assert(accepted == kRingRecords / 4);
+    AsyncWriter::instance().flush();
+    assert(drained == kRingRecords / 4 * record.size());
+    assert(ring.dropped() == 0 && ring.size() == 0);
+    AsyncWriter::instance().detach(ring);
+
+    // Test 2: Past capacity the rest is dropped, a detached ring is drained first
+    drained = 0;
+    RecordRing full(count);
+    accepted = 0;
+    for (size_t i = 0; i < kRingRecords + 10; ++i)
+        accepted += full.push(record);
+    assert(accepted == kRingRecords && full.dropped() == 10);
+    const bool attached_full = AsyncWriter::instance().attach(full);
+    assert(attached_full);
+    AsyncWriter::instance().detach(full);
+    assert(drained == kRingRecords * record.size());
+
+    // Test 3: Async sinks of several threads
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i)
+        threads.emplace_back(write_thread_file, i);
+    for (auto& t : threads) t.join();
+    std::cout << "LoggerSink: Async tests OK\n";
+
+    (void)attached;
+    (void)attached_full;
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include "../../srcs/logging/log_decoder.hpp"
+
+
+// Command lines fo testing
+// g++ -std=c++2a -O2 -Wall -Wextra -Werror ../../srcs/globals.cpp test_binary_log.cpp -o binary_log
+// ./binary_log
+using namespace logging;
+
+struct Point { int x, y; };
+std::ostream& operator<<(std::ostream& os, const Point& p) {
+    return os << '(' << p.x << ", " << p.y << ')';
+}
+
+// A global logger into a buffer: the text formatter the decoder must match
+struct BufferLogger : GlobalLogger {
+    BufferLogger() noexcept { set_output(io::Output::Buffer); }
+    [[nodiscard]] sv_t view() const noexcept { return sink_.view_buffer(); }
+};
+
+#define ref_msg(level, fmt, ...) \
+    ref.bin(Level::level, FormatCatalog::id(fmt) __VA_OPT__(, ) __VA_ARGS__)
+
+// One call site per format, each argument type at least once
+#define log_all(log) do { \
+    log(Info, "int {} {}, uint {} {}\n", -7, INT64_MIN, 42u, UINT64_MAX); \
+    log(Warn, "bool {} {}, char {}\n", true, false, 'x'); \
+    log(Time, "double {}, float {}\n", 0.5, 1.25f); \
+    log(Ok,   "str {} {} {}, streamed {}\n", "literal", std::string("string"), sv_t{"view"}, Point{3, -4}); \
+    log(Error, "extra args:", 1, 2); \
+} while (0)
+
+constexpr int kSites = 5;
+
+std::string read_file(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    assert(in && "binary log not written");
+    return {std::istreambuf_iterator<char>(in), {}};
+}
+
+// Counts the records of each kind and checks every format is defined once
+void check_records(sv_t bytes, int& defs, int& msgs) {
+    RecordReader r(bytes);
+    sv_t magic;
+    const bool has_magic = r.get(magic, kBinaryMagic.size());
+    assert(has_magic && magic == kBinaryMagic);
+    (void)has_magic;
+    defs = msgs = 0;
+    while (!r.empty()) {
+        RecordKind kind{};
+        uint16_t   size = 0;
+        sv_t       payload;
+        const bool has_record = r.get(kind) && r.get(size) && r.get(payload, size);
+        assert(has_record);
+        (void)has_record;
+        if (kind == RecordKind::Def) {
+            RecordReader def(payload);
+            uint32_t id = 0;
+            const bool has_id = def.get(id);
+            assert(has_id && id == uint32_t(defs));
+            (void)has_id;
+            assert(def.rest() == FormatCatalog::text(id));
+            ++defs;
+        } else {
+            assert(kind == RecordKind::Msg);
+            const auto m = decode_msg(payload);
+            assert(m && m->fmt_id < uint32_t(defs));
+            ++msgs;
+        }
+    }
+}
+
+int main(int ac, char** av) {
+    rt::config.init(ac, av);
+    const char* path = "logs/binary_test.log";
+    std::filesystem::remove(path);
+
+    // Each call site logs twice: its format is registered and written once
+    make_global_logger().set_output(io::Output::Binary | io::Output::CreateDirs, path);
+    for (int i = 0; i < 2; ++i)
+        log_all(bin_msg);
+    make_global_logger().set_output(io::Output::Stdout);
+    const std::string bytes = read_file(path);
+
+    int defs = 0, msgs = 0;
+    check_records(bytes, defs, msgs);
+    assert(defs == kSites + 1);              // id 0 is the plain text format
+    assert(FormatCatalog::size() == uint32_t(kSites + 1));
+    assert(msgs == 2 * kSites);
+
+    BufferLogger ref;
+    for (int i = 0; i < 2; ++i)
+        log_all(ref_msg);
+
+    oss_t decoded;
+    const auto decoded_ret = decode_binary_log(bytes, decoded, false, io::Output::Buffer);
+    assert(decoded_ret.ok());
+    (void)decoded_ret;
+    assert(decoded.view() == ref.view());
+    assert(decoded.view().find("int -7 -9223372036854775808, uint 42 18446744073709551615")
+                                                                        != sv_t::npos);
+    assert(decoded.view().find("bool 1 0, char x") != sv_t::npos);
+    assert(decoded.view().find("double 0.5, float 1.25") != sv_t::npos);
+    assert(decoded.view().find("str literal string view, streamed (3, -4)") != sv_t::npos);
+    assert(decoded.view().find("extra args:12") != sv_t::npos);
+
+    // A record cut by a crash: everything before it is still decoded
+    std::string truncated = bytes;
+    truncated += static_cast<char>(RecordKind::Msg);
+    const uint16_t size = 100;
+    truncated.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    truncated += "abc";
+    oss_t partial;
+    const auto ret = decode_binary_log(truncated, partial, false, io::Output::Buffer);
+    assert(!ret.ok() && ret.status == "Truncated record");
+    assert(partial.view() == ref.view());
+
+    oss_t bad;
+    const auto bad_ret = decode_binary_log("not a log", bad);
+    assert(!bad_ret.ok());
+    (void)bad_ret;
+
+    std::cout << decoded.view() << "test_binary_log.cpp OK!\n";
+    return 0;
+}
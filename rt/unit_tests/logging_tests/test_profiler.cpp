@@ -0,0 +1,89 @@
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "../../srcs/logging/profiler.hpp"
+
+// Command lines fo testing
+// g++ -std=c++2a -O2 -Wall -Wextra -Werror -DRT_PROFILE test_profiler.cpp -o profiler
+// ./profiler && open chrome://tracing, load logs/profile.json
+// g++ -std=c++2a -O2 -Wall -Wextra -Werror test_profiler.cpp -o profiler  # no-op scopes
+
+void time_delay(int us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void trace_tile(int i) {
+    profile_function();
+    time_delay(100 + 10 * (i % 7));
+    {
+        profile_scope("shading");
+        time_delay(50);
+    }
+}
+
+void preview() {
+    profile_scope("preview");
+    profile_scope("shading");   // same label, another path than trace_tile's
+    time_delay(20);
+}
+
+void render_pass(int pass) {
+    profile_scope("render pass");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([pass, t] {
+            profile_scope("worker");
+            for (int i = 0; i < 8; ++i) trace_tile(pass * 32 + t * 8 + i);
+        });
+    for (auto& t : threads) t.join();
+}
+
+int main() {
+    using namespace logging;
+    {
+        profile_scope("scene build");
+        time_delay(2000);
+    }
+    for (int pass = 0; pass < 3; ++pass) render_pass(pass);
+    preview();
+
+    // Nearest-rank percentiles
+    std::vector<uint64_t> d{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    assert(Profiler::percentile(d, 50) == 5 && Profiler::percentile(d, 99) == 10);
+    assert(Profiler::percentile({7}, 50) == 7 && Profiler::percentile({7}, 99) == 7);
+    d.clear();
+    for (uint64_t i = 1; i <= 200; ++i) d.push_back(i);
+    assert(Profiler::percentile(d, 99) == 198 && Profiler::percentile(d, 100) == 200);
+
+#if defined(RT_PROFILE)
+    // Aggregated by path, in tree order
+    const auto stats = Profiler::stats();
+    const auto find = [&](std::vector<sv_t> path) {
+        const auto it = std::find_if(stats.begin(), stats.end(),
+                                     [&](const auto& s) { return s.path == path; });
+        assert(it != stats.end());
+        return it;
+    };
+    const auto tile = find({"worker", "trace_tile"});
+    assert(tile->count == 96 && tile->depth == 1);
+    assert(find({"worker", "trace_tile", "shading"})->count == 96);
+    assert(find({"preview", "shading"})->count == 1);
+    assert(find({"render pass"})->count == 3);
+    for (auto s = stats.begin(); s != stats.end(); ++s) {
+        assert(s->min <= s->p50 && s->p50 <= s->p99 && s->p99 <= s->max);
+        if (s->depth == 0) continue;
+        auto parent = s->path;
+        parent.pop_back();
+        assert(find(parent) < s);
+    }
+#endif
+
+    Profiler::write_stats(std::cout);
+    std::ofstream file("logs/profile.json");
+    if (file) Profiler::write_chrome_trace(file);
+    std::cout << (file ? "Trace written to 'logs/profile.json'\n"
+                       : "Cannot open 'logs/profile.json'\n");
+    return 0;
+}
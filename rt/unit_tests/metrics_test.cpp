@@ -0,0 +1,42 @@
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "../srcs/config.hpp"
+
+// g++ -std=c++2a -O2 -Wall -Wextra -Werror ../srcs/globals.cpp metrics_test.cpp -o metrics
+// ./metrics --metrics-dump --metrics-file=logs/metrics.csv
+// ./metrics --metrics-file=logs/metrics.json
+using namespace common;
+
+void test_reduce() {
+    MetricsRegistry::reset();
+    constexpr int threads = 4;
+    constexpr int rays    = 100000;
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t)
+        pool.emplace_back([] {
+            PassMetric pass;
+            for (int i = 0; i < rays; ++i) {
+                metric_add(Metric::PrimaryRays);
+                metric_add(Metric::IntersectionTests, 3);
+            }
+            metric_add(Metric::Samples, rays);
+        });
+    for (auto& t : pool) t.join();
+    const MetricValues v = MetricsRegistry::snapshot();
+    assert(v[size_t(Metric::PrimaryRays)] == uint64_t(threads) * rays);
+    assert(v[size_t(Metric::IntersectionTests)] == uint64_t(threads) * rays * 3);
+    assert(v[size_t(Metric::Passes)] == threads);
+    assert(v[size_t(Metric::PassTimeNs)] > 0);
+    assert(rays_per_second(v) > 0);
+    assert(alignof(MetricCounters) == 64);
+    write_metrics_json(std::cout, v);
+}
+
+int main(int ac, char** av) {
+    rt::config.init(ac, av);
+    test_reduce();
+    std::cout << "metrics_test.cpp OK!\n";
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 # include "Ray.hpp"
 # include "PhotonMap.hpp"
+# include "Bvh.hpp"
 
 
 struct	Ray;
@@ -10,7 +11,7 @@ struct	Rays;
 struct	HitRecord;
 class	PhotonMap;
 typedef	Rays			phRays_t;
-typedef	std::mt19937	rand_gen_t;
+typedef	Random			rand_gen_t;
 
 
 class A_Scenery {
@@ -95,9 +96,8 @@ public:
 	virtual int   getColor(const HitRecord& rec) const = 0;
 	virtual bool  getLight(Ray& ray) const = 0;
 	virtual void  getNormal(Ray& ray) const = 0;
-	virtual void  lookat(const Position& eye, const LookatAux& aux, const Vec3f& pos, float roll) = 0;
-	virtual void  roll(const Vec3f& pos, float shiftRoll) = 0;
 	virtual bool  intersection(Ray& ray) = 0;
+	virtual bool  getBounds(Aabb& box) const = 0;	// false if unbounded
 	virtual float lighting(Ray& ray) const = 0;
 	virtual bool  isGlowing(Ray& ray) const = 0;
 	virtual void  photonEmissions(int num, phRays_t& rays) const = 0;
@@ -107,12 +107,25 @@ public:
 
 
 struct Scenerys : public std::vector<A_Scenery*> {
-	Scenerys(void) : std::vector<A_Scenery*>() {}
+	Bvh	bvh;
+	int	maxChain;	// primitives in the longest CSG combination
+	Scenerys(void) : std::vector<A_Scenery*>(), bvh(), maxChain(1) {}
 	~Scenerys(void) {}
 	Scenerys& clear(int n) {
 		Scenerys tmp;
 		if (n) tmp.reserve(n);
 		swap(tmp);
+		bvh.clear();
+		maxChain = 1;
+		return *this;
+	}
+	inline Scenerys& update(void) {
+		maxChain = 1;
+		for (int chain = 1, i = 0, n = (int)size(); i < n; i++) {
+			chain = (*this)[i]->combineType == END ? 1 : chain + 1;
+			maxChain = std::max(maxChain, chain);
+		}
+		bvh.update(*this);
 		return *this;
 	}
 };
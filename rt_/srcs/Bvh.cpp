@@ -0,0 +1,183 @@
+#include "Bvh.hpp"
+#include "A_Scenery.hpp"
+
+
+// Class Bvh
+
+Bvh::Bvh(void) : _nodes(), _items(), _unbounded(), _size(0), _cost(0) {}
+
+Bvh::Bvh(const Bvh& other) :
+_nodes(other._nodes),
+_items(other._items),
+_unbounded(other._unbounded),
+_size(other._size),
+_cost(other._cost)
+{}
+
+Bvh::~Bvh(void) {}
+
+Bvh& Bvh::operator=(const Bvh& other) {
+	if (this != &other) {
+		_nodes = other._nodes;
+		_items = other._items;
+		_unbounded = other._unbounded;
+		_size = other._size;
+		_cost = other._cost;
+	}
+	return *this;
+}
+
+void Bvh::clear(void) {
+	_nodes.clear();
+	_items.clear();
+	_unbounded.clear();
+	_size = 0;
+	_cost = 0;
+}
+
+void Bvh::collectItems(const Scenerys& scenerys, std::vector<Item>& items, std::vector<Item>& unbounded) const {
+	for (int first = 0, size = (int)scenerys.size(); first < size;) {
+		Item item = {first, first, Aabb()};
+		bool bounded = true;
+		do {
+			Aabb box;
+			bounded = scenerys[item.last]->getBounds(box) && bounded;
+			item.box.expand(box);
+		} while (scenerys[item.last++]->combineType != END && item.last < size);
+		if (!bounded) {
+			unbounded.push_back(item);
+		} else if (!item.box.isEmpty()) {	// point and direct lights are never hit
+			item.box.expand(item.box.min - Vec3f(EPSILON, EPSILON, EPSILON));
+			item.box.expand(item.box.max + Vec3f(EPSILON, EPSILON, EPSILON));
+			items.push_back(item);
+		}
+		first = item.last;
+	}
+}
+
+// Inner nodes deeper than BVH_STACK_SIZE - 2 could overflow the traversal stack, which
+// holds the farther child of every level above plus both children of the current node.
+// Near that depth SAH splits give way to median splits, whose subtree depth is known.
+int Bvh::buildNode(int first, int count, int depth) {
+	int idx = (int)_nodes.size();
+	_nodes.push_back({Aabb(), first, count});
+	Aabb box, centroids;
+	for (int i = first; i < first + count; i++) {
+		box.expand(_items[i].box);
+		centroids.expand(_items[i].box.centroid());
+	}
+	_nodes[idx].box = box;
+	if (count <= BVH_LEAF_SIZE)
+		return idx;
+	int		medianLevels = 0;
+	for (int n = count; n > BVH_LEAF_SIZE; n = (n + 1) / 2)
+		medianLevels++;
+	bool	sah = depth + medianLevels < BVH_STACK_SIZE - 2;
+	int		axis = -1, split = 0;
+	float	bestCost = box.area() * count;	// cost of keeping a leaf
+	for (int a = 0; a < 3 && sah; a++) {
+		float lo = centroids.min.raw[a], extent = centroids.max.raw[a] - lo;
+		if (extent <= 0)
+			continue;
+		Aabb	bins[BVH_BINS];
+		int		counts[BVH_BINS] = {0};
+		for (int i = first; i < first + count; i++) {
+			int b = std::min(BVH_BINS - 1, (int)((_items[i].box.centroid().raw[a] - lo) / extent * BVH_BINS));
+			bins[b].expand(_items[i].box);
+			counts[b]++;
+		}
+		float	rightArea[BVH_BINS];
+		int		rightCount[BVH_BINS];
+		Aabb	acc;
+		int		n = 0;
+		for (int b = BVH_BINS - 1; b > 0; b--) {
+			acc.expand(bins[b]);
+			n += counts[b];
+			rightArea[b] = acc.area();
+			rightCount[b] = n;
+		}
+		acc = Aabb();
+		n = 0;
+		for (int b = 0; b < BVH_BINS - 1; b++) {
+			acc.expand(bins[b]);
+			n += counts[b];
+			float cost = acc.area() * n + rightArea[b + 1] * rightCount[b + 1];
+			if (n && rightCount[b + 1] && cost < bestCost) {
+				bestCost = cost;
+				axis = a;
+				split = b + 1;
+			}
+		}
+	}
+	int mid = first + count / 2;
+	if (axis >= 0) {
+		float lo = centroids.min.raw[axis], extent = centroids.max.raw[axis] - lo;
+		auto it = std::partition(_items.begin() + first, _items.begin() + first + count, [&](const Item& item){
+			return std::min(BVH_BINS - 1, (int)((item.box.centroid().raw[axis] - lo) / extent * BVH_BINS)) < split;
+		});
+		mid = (int)(it - _items.begin());
+	} else if (sah && count <= 2 * BVH_LEAF_SIZE) {
+		return idx;
+	} else {	// no split beats a leaf but the leaf is too large, or too deep: median split on the widest axis
+		Vec3f d = centroids.max - centroids.min;
+		int a = d.x > d.y && d.x > d.z ? 0 : (d.y > d.z ? 1 : 2);
+		std::nth_element(_items.begin() + first, _items.begin() + mid, _items.begin() + first + count,
+			[a](const Item& l, const Item& r){ return l.box.centroid().raw[a] < r.box.centroid().raw[a]; });
+	}
+	_nodes[idx].count = 0;
+	buildNode(first, mid - first, depth + 1);
+	int right = buildNode(mid, first + count - mid, depth + 1);
+	_nodes[idx].first = right;
+	return idx;
+}
+
+float Bvh::cost(void) const {
+	if (_nodes.empty() || _nodes[0].box.area() <= 0)
+		return 0;
+	float sum = 0;
+	for (auto node = _nodes.begin(), end = _nodes.end(); node != end; ++node)
+		sum += node->box.area() * (node->count ? node->count : 1);
+	return sum / _nodes[0].box.area();
+}
+
+void Bvh::build(const Scenerys& scenerys) {
+	profile_scope("bvh build");
+	clear();
+	collectItems(scenerys, _items, _unbounded);
+	if (!_items.empty()) {
+		_nodes.reserve(2 * _items.size());
+		buildNode(0, (int)_items.size(), 0);
+	}
+	_size = scenerys.size();
+	_cost = cost();
+}
+
+bool Bvh::refit(const Scenerys& scenerys) {
+	if (_size != scenerys.size())
+		return false;
+	std::vector<Item> items, unbounded;
+	collectItems(scenerys, items, unbounded);
+	if (items.size() != _items.size() || unbounded.size() != _unbounded.size())
+		return false;
+	std::vector<Aabb> boxes(scenerys.size());
+	for (auto item = items.begin(), end = items.end(); item != end; ++item)
+		boxes[item->first] = item->box;
+	for (auto item = _items.begin(), end = _items.end(); item != end; ++item)
+		item->box = boxes[item->first];
+	for (int i = (int)_nodes.size() - 1; i >= 0; i--) {	// children always follow their parent
+		Node& node = _nodes[i];
+		node.box = Aabb();
+		if (node.count) {
+			for (int j = node.first, end = node.first + node.count; j < end; j++)
+				node.box.expand(_items[j].box);
+		} else {
+			node.box.expand(_nodes[i + 1].box).expand(_nodes[node.first].box);
+		}
+	}
+	return cost() <= _cost * BVH_REBUILD_RATIO;
+}
+
+void Bvh::update(const Scenerys& scenerys) {
+	if (!refit(scenerys))
+		build(scenerys);
+}
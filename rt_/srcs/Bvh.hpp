@@ -0,0 +1,107 @@
+#ifndef BVH_HPP
+# define BVH_HPP
+
+# include <vector>
+# include "geometry.hpp"
+# include "Metrics.hpp"
+
+class	A_Scenery;
+struct	Scenerys;
+
+# define BVH_BINS				12		// SAH buckets per split axis
+# define BVH_LEAF_SIZE			4		// max items per leaf
+# define BVH_STACK_SIZE			64		// traversal stack, buildNode keeps the tree shallow enough for it
+# define BVH_REBUILD_RATIO		1.5f	// refit is dropped for a rebuild when SAH cost grows beyond
+
+
+// class Bvh
+// Flattened SAH bounding volume hierarchy over a Scenerys collection. Items are index
+// ranges of the collection: a single primitive, or a whole CSG group (combineType != END
+// up to its closing END primitive), which is never split. Items without bounds
+// (infinite planes) are kept aside and visited before the tree.
+class Bvh {
+public:
+	struct Item {
+		int		first;
+		int		last;	// one past the last primitive of the item
+		Aabb	box;
+	};
+	struct Node {
+		Aabb	box;
+		int		first;	// leaf: first item, inner node: index of the second child
+		int		count;	// leaf: number of items, inner node: 0
+	};
+private:
+	std::vector<Node>	_nodes;		// depth-first order, the first child follows its parent
+	std::vector<Item>	_items;		// bounded items in leaf order
+	std::vector<Item>	_unbounded;
+	size_t				_size;		// size of the collection the tree was built for
+	float				_cost;		// SAH cost at build time
+	int  buildNode(int first, int count, int depth);
+	void collectItems(const Scenerys& scenerys, std::vector<Item>& items, std::vector<Item>& unbounded) const;
+	float cost(void) const;
+public:
+	Bvh(void);
+	Bvh(const Bvh& other);
+	~Bvh(void);
+	Bvh& operator=(const Bvh& other);
+	inline bool   empty(void) const { return _nodes.empty() && _unbounded.empty(); }
+	inline bool   isBuiltFor(const std::vector<A_Scenery*>& scenerys) const { return !empty() && _size == scenerys.size(); }
+	inline size_t get_nodesNumber(void) const { return _nodes.size(); }
+	void clear(void);
+	void build(const Scenerys& scenerys);
+	bool refit(const Scenerys& scenerys);
+	void update(const Scenerys& scenerys);
+
+	// Calls visit(first, last) for every item whose bounds the ray can reach before
+	// 'distance', nearest child first. visit may shorten 'distance' and returns true
+	// to stop the traversal (any hit for shadow rays). Counts the nodes it visits.
+	template <class Visit>
+	bool traverse(const Vec3f& pov, const Vec3f& dir, const float& distance, Visit visit) const {
+		for (auto item = _unbounded.begin(), end = _unbounded.end(); item != end; ++item)
+			if (visit(item->first, item->last))
+				return true;
+		if (_nodes.empty())
+			return false;
+		Vec3f invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+		int stack[BVH_STACK_SIZE];
+		int top = 0, visited = 0;
+		float d1, d2;
+		if (!_nodes[0].box.intersection(pov, invDir, distance, d1))
+			return false;
+		stack[top++] = 0;
+		while (top) {
+			const Node& node = _nodes[stack[--top]];
+			visited++;
+			if (node.count) {
+				for (int i = node.first, end = node.first + node.count; i < end; i++) {
+					if (_items[i].box.intersection(pov, invDir, distance, d1) &&
+						visit(_items[i].first, _items[i].last)) {
+						metric_add(Metric::BvhNodesVisited, visited);
+						return true;
+					}
+				}
+				continue;
+			}
+			int left = (int)(&node - &_nodes[0]) + 1, right = node.first;
+			bool hitLeft = _nodes[left].box.intersection(pov, invDir, distance, d1);
+			bool hitRight = _nodes[right].box.intersection(pov, invDir, distance, d2);
+			if (hitLeft && hitRight) {
+				if (d1 < d2)
+					std::swap(left, right);
+				stack[top++] = left;	// farther child waits on the stack
+				stack[top++] = right;
+			} else if (hitLeft) {
+				stack[top++] = left;
+			} else if (hitRight) {
+				stack[top++] = right;
+			}
+		}
+		metric_add(Metric::BvhNodesVisited, visited);
+		return false;
+	}
+};
+// class Bvh end
+
+
+#endif /* BVH_HPP */
@@ -8,6 +8,7 @@
 //# define DEBUG_PATH			"/Users/anna/42/rt/"
 # define CONTROLS_FILE		"scenes/controls"
 # define PARSING_LOGFILE	"parsing.log"
+# define DEFAULT_PICTURE	"frame.ppm"
 # define TEXTURE_KEY		"txtr:"
 # define SUCCESS					0
 # define ERROR						-1
@@ -23,7 +24,12 @@
 # define LIGHTS_GLOWING_FACTOR		4
 # define DAFAULT_SMOOTHING_FACTOR	1
 # define DEFAULT_RECURSION_DEPTH	5
+# define DEFAULT_SHADOW_RAYS		4		// per hit and kind of light; a hit with more lights picks this many
+# define SHADOW_RAYS_MAX			64
 # define DAFAULT_PATHS_PER_RAY		pprs[2]
+# define PATHS_PER_PASS				1		// diffuse paths per hit in one PATH pass, 'paths' passes refine the picture
+# define RR_MIN_BOUNCES				2		// PATH bounces before Russian roulette may end a path
+# define RR_MAX_SURVIVAL			0.95f	// even a bright path goes on with at most this probability
 # define BASE						Vec3f(0,0,0),Vec3f(0,0,1)
 # define PRECISION					1e-9
 # define EPSILON 					1e-3
@@ -40,8 +46,16 @@
 # define TOTAL_PHOTONS_POWER		1.0f
 # define PHOTON_SURVIVAL			1.0f
 # define CONE_FILTER_COEFFICIENT	10.0f
+# define PHOTON_MAP_FRAME			~0ULL	// random sequences key of the photon map pass
 
-# define PIXELS_PER_THREAD			4000
+# define PIXELS_PER_TILE				1024
+# define DEFAULT_TILE_SIZE			16		// side in pixels of the square tiles rays are traced by
+# define TILE_SIZE_MIN				4
+# define TILE_SIZE_MAX				256
+# define AA_CONTRAST_THRESHOLD		12		// 8-bit step to a neighbour that makes a pixel take all its samples
+# define PHOTONS_PER_TILE			4096
+# define SEGMENTS_PER_PRIMITIVE		2		// CSG scratch: a subtraction can split one segment in two
+# define PARALLEL_SORT_MIN			4096	// min elements per thread worth a parallel sort
 # define RESTORE_RAYS				1
 # define RESET_RAYS					2
 # define TAKE_PICTURE				3
@@ -84,16 +98,19 @@ enum Controls {
 	DIRECT_LIGHTING,
 	BACKGROUND_LIGHT,
 	RAYTRACING,
-	PATHTRACING
+	PATHTRACING,
+	PHOTON_SEARCH
 };
 
 class MlxImage;
 struct Scene;
+struct Options;
 
 struct Var {
 	MlxImage*	img;
 	Scene*		scene;
-	Var(void) : img(NULL), scene(NULL) {}
+	Options*	options;
+	Var(void) : img(NULL), scene(NULL), options(NULL) {}
 	~Var(void) {}
 };
 
@@ -0,0 +1,56 @@
+#include "KdTree.hpp"
+
+
+// Class KdTree
+
+KdTree::KdTree(void) : _nodes() {}
+
+KdTree::KdTree(const KdTree& other) : _nodes(other._nodes) {}
+
+KdTree::~KdTree(void) {}
+
+KdTree& KdTree::operator=(const KdTree& other) {
+	if (this != &other) {
+		_nodes = other._nodes;
+	}
+	return *this;
+}
+
+// Puts the median of nodes[first, last) at _nodes[idx] so that the left subtree gets
+// every full level plus as much of the bottom level as it can hold.
+void KdTree::balance(std::vector<Node>& nodes, int first, int last, int idx) {
+	int count = last - first;
+	if (count == 1) {
+		_nodes[idx] = nodes[first];
+		_nodes[idx].axis = 0;
+		return;
+	}
+	int full = 1;
+	while (2 * full + 1 <= count)	// nodes of the full levels: 2^h - 1
+		full = 2 * full + 1;
+	int half = (full + 1) / 2, bottom = count - full;
+	int mid = first + (half - 1) + std::min(bottom, half);
+	Aabb box;
+	for (int i = first; i < last; i++)
+		box.expand(nodes[i].point);
+	Vec3f d = box.max - box.min;
+	int axis = d.x > d.y && d.x > d.z ? 0 : (d.y > d.z ? 1 : 2);
+	std::nth_element(nodes.begin() + first, nodes.begin() + mid, nodes.begin() + last,
+		[axis](const Node& l, const Node& r){ return l.point.raw[axis] < r.point.raw[axis]; });
+	_nodes[idx] = nodes[mid];
+	_nodes[idx].axis = axis;
+	balance(nodes, first, mid, 2 * idx + 1);
+	if (mid + 1 < last)
+		balance(nodes, mid + 1, last, 2 * idx + 2);
+}
+
+void KdTree::build(const std::vector<Vec3f>& points, int begin, int end) {
+	_nodes.clear();
+	if (begin >= end)
+		return;
+	std::vector<Node> nodes(end - begin);
+	for (int i = begin; i < end; i++)
+		nodes[i - begin] = {points[i], i, 0};
+	_nodes.resize(nodes.size());
+	balance(nodes, 0, (int)nodes.size(), 0);
+}
@@ -0,0 +1,74 @@
+#ifndef KDTREE_HPP
+# define KDTREE_HPP
+
+# include <vector>
+# include <algorithm>
+# include "geometry.hpp"
+
+
+// class KdTree
+// Left-balanced kd-tree (H.W. Jensen, "Realistic Image Synthesis Using Photon Mapping")
+// over a range of photon traces. Node i has its children at 2i+1 and 2i+2, so the tree
+// is a plain array: no pointers and no empty slots.
+class KdTree {
+public:
+	struct Node {
+		Vec3f	point;
+		int		trace;	// index of the trace in the photon map
+		int		axis;
+	};
+	struct Neighbour {
+		float	sqrDistance;
+		int		trace;
+		inline bool operator<(const Neighbour& other) const { return sqrDistance < other.sqrDistance; }
+	};
+private:
+	std::vector<Node>	_nodes;
+	void balance(std::vector<Node>& nodes, int first, int last, int idx);
+	template <class Accept>
+	void locate(int idx, const Vec3f& point, float& maxSqr, Neighbour* heap, int& n, int k, Accept& accept) const {
+		const Node& node = _nodes[idx];
+		int left = 2 * idx + 1, size = (int)_nodes.size();
+		if (left < size) {
+			float delta = point.raw[node.axis] - node.point.raw[node.axis];
+			int near = delta < 0 ? left : left + 1, far = delta < 0 ? left + 1 : left;
+			if (near < size)
+				locate(near, point, maxSqr, heap, n, k, accept);
+			if (far < size && delta * delta <= maxSqr)
+				locate(far, point, maxSqr, heap, n, k, accept);
+		}
+		float sqr = (node.point - point).sqnorm();
+		if (sqr > maxSqr || (n == k && sqr >= heap[0].sqrDistance) || !accept(node.trace))
+			return;
+		if (n == k)
+			std::pop_heap(heap, heap + n--);
+		heap[n++] = {sqr, node.trace};
+		std::push_heap(heap, heap + n);
+		if (n == k)
+			maxSqr = heap[0].sqrDistance;
+	}
+public:
+	KdTree(void);
+	KdTree(const KdTree& other);
+	~KdTree(void);
+	KdTree& operator=(const KdTree& other);
+	inline bool empty(void) const { return _nodes.empty(); }
+	void build(const std::vector<Vec3f>& points, int begin, int end);
+
+	// Puts the k nearest traces within 'radius' that pass accept(trace) in 'nearest',
+	// a caller's buffer of k entries, in ascending order of distance. Returns their number.
+	template <class Accept>
+	int nearest(const Vec3f& point, float radius, int k, Neighbour* nearest, Accept accept) const {
+		if (_nodes.empty() || k <= 0)
+			return 0;
+		float maxSqr = radius * radius;
+		int n = 0;
+		locate(0, point, maxSqr, nearest, n, k, accept);
+		std::sort_heap(nearest, nearest + n);
+		return n;
+	}
+};
+// class KdTree end
+
+
+#endif /* KDTREE_HPP */
@@ -1,12 +1,13 @@
 #include "Light.hpp"
 
 
-Light::Light(void) : A_Scenery("light", "l", true), _type(SPOTLIGHT), _planar(NULL) {}
+Light::Light(void) : A_Scenery("light", "l", true), _type(SPOTLIGHT), _planar(NULL), _pick(0) {}
 
 Light::Light(const std::string& name, const std::string& nick, Type type, A_Planar* planar) :
 A_Scenery(name, nick, true),
 _type(type),
-_planar(planar)
+_planar(planar),
+_pick(0)
 {}
 
 Light::~Light(void) {
@@ -19,7 +20,8 @@ Light::~Light(void) {
 Light::Light(const Light& other) :
 A_Scenery(other),
 _type(other._type),
-_planar(other._planar) {
+_planar(other._planar),
+_pick(other._pick) {
 }
 
 Light* Light::clone(void) const {
@@ -66,6 +68,36 @@ void Light::output(std::ostringstream& os) const {
 }
 
 
+// struct LightPicker
+
+LightPicker::LightPicker(void) : std::vector<Light*>(), pick(), table() {}
+
+LightPicker::~LightPicker(void) {}
+
+// The lights of 'lights' with some power; planar ones by their glowing surface if 'surface'
+void LightPicker::update(const std::vector<Light*>& lights, bool surface) {
+	clear();
+	pick.clear();
+	float total = 0;
+	for (auto light = lights.begin(), end = lights.end(); light != end; ++light) {
+		float power = (*light)->power(surface);
+		if (surface)
+			(*light)->set_pick(0);
+		if (power > 0) {
+			push_back(*light);
+			pick.push_back(power);
+			total += power;
+		}
+	}
+	table.build(pick);
+	for (size_t i = 0; i < size(); i++) {
+		pick[i] /= total;
+		if (surface)
+			(*this)[i]->set_pick(pick[i]);
+	}
+}
+
+
 // Non member functions
 
 std::ostream& operator<<(std::ostream& o, const Light& l) {
@@ -17,6 +17,7 @@ public:
 protected:
 	Type		_type;
 	A_Planar*	_planar;
+	float		_pick;	// chance next-event estimation picks this planar light with, see LightPicker
 public:
 	Light(void);
 	Light(const std::string& name, const std::string& nick, Type type, A_Planar* planar);
@@ -56,18 +57,6 @@ public:
 		else
 			ray.norm = _pos.p - ray.pov;
 	}
-	inline void  lookat(const Position& eye, const LookatAux& aux, const Vec3f& pos, float roll) {
-		(void)pos;
-		_pos.lookat(eye, aux, roll);
-		if (_planar)
-		_planar->lookat(eye, aux, roll);
-	}
-	inline void  roll(const Vec3f& pos, float roll) {
-		(void)pos;
-		_pos.roll(roll);
-		if (_planar)
-			_planar->roll(roll);
-	}
 	inline bool  intersection(Ray& ray) {
 		switch (_type) {
 			case SPOTLIGHT:		return false;
@@ -76,6 +65,14 @@ public:
 		}
 		return _planar->intersection(ray.pov, ray.dir, ray.dist, ray.intersections.a.d, ray.intersections.b.d, ray.set_hit(FRONT).hit);
 	}
+	inline bool  getBounds(Aabb& box) const {
+		switch (_type) {
+			case SPOTLIGHT:		return true;	// empty box, never intersected
+			case DIRECTLIGHT:	return true;
+			default: break;
+		}
+		return _planar->bounds(box);
+	}
 	inline float lighting(Ray& ray) const {
 		ray.getDir2Light(_pos);
 		float k = ray.dir * ray.norm;
@@ -86,15 +83,30 @@ public:
 		return 0;
 	}
 	inline bool  isGlowing(Ray& ray) const {
-		if (isPlanar()) {
-			if (isTexture())
-				ray.paint = _planar->getTextureRgba(_planar->localHitPoint(ray.pov, ray.dir, ray.dist));
-			else
-				ray.paint = _light.get_glow();
-			ray.paint *= (LIGHTS_GLOWING_FACTOR * _light.get_ratio());
-		}
+		if (isPlanar())
+			ray.paint = glowing(_planar->localHitPoint(ray.pov, ray.dir, ray.dist));
 		return true;
 	}
+	// Light the surface of a planar light glows with at the point 'localHitPoint'
+	inline Rgb   glowing(const Vec3f& localHitPoint) const {
+		Rgb glow(isTexture() ? _planar->getTextureRgba(localHitPoint) : _light.get_glow());
+		glow *= (LIGHTS_GLOWING_FACTOR * _light.get_ratio());
+		return glow;
+	}
+	// Estimated power of the light, what it is picked in proportion to; of the glowing
+	// surface of a planar light if 'surface'
+	inline float power(bool surface) const {
+		if (surface && !isPlanar())
+			return 0;
+		Rgb light(surface ? Rgb(isTexture() ? 0xFFFFFF : _light.get_glow()) : get_light());
+		float power = std::max(light.get_band(0), std::max(light.get_band(1), light.get_band(2)));
+		return surface ? power * LIGHTS_GLOWING_FACTOR * _light.get_ratio() * _planar->area() : power;
+	}
+	// Solid angle density of a random point of the surface seen in the direction 'dir' at the distance 'dist'
+	inline float surfacePdf(const Vec3f& dir, float dist) const {
+		float cosine = std::abs(dir * _planar->pos.n);
+		return cosine > 0 ? dist * dist / (_planar->area() * cosine) : 0;
+	}
 	void photonEmissions(int num, phRays_t& rays) const;
 	void output(std::ostringstream& os) const;
 	friend std::ostream& operator<<(std::ostream& o, const Light& l);
@@ -106,7 +118,26 @@ public:
 	inline bool  isMultispot(void) const { return _type == SPOTLIGHT_CIRCULAR || _type == SPOTLIGHT_RECTANGULAR; }
 
 	inline A_Planar* get_planar(void) const { return _planar; }
+	inline float get_pick(void) const { return _pick; }
+	inline void  set_pick(float pick) { _pick = pick; }
 	friend std::istringstream& operator>>(std::istringstream& is, Light& l);
 };
 
+
+// Lights picked in proportion to their power: a hit gets a shadow ray to each of them if
+// they are few, else to a few picked ones, so its cost does not grow with their number
+struct LightPicker : public std::vector<Light*> {
+	std::vector<float>	pick;	// chance each light is picked with
+	AliasTable			table;
+	LightPicker(void);
+	~LightPicker(void);
+	void	update(const std::vector<Light*>& lights, bool surface);
+	inline int	 sample(double chance) const { return table.sample(chance); }
+	inline bool  isPicking(int shadowRays) const { return (int)size() > shadowRays; }
+	// Shadow rays a hit casts to the planar 'light' on average
+	inline float picks(const Light* light, int shadowRays) const {
+		return isPicking(shadowRays) ? shadowRays * light->get_pick() : (light->get_pick() ? 1 : 0);
+	}
+};
+
 #endif /* LIGHT_HPP */
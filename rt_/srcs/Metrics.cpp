@@ -0,0 +1,32 @@
+#include <iostream>
+#include <fstream>
+#include "Metrics.hpp"
+#include "Header.h"
+
+
+int outputMetrics(bool dump, const std::string& filename) {
+	if (dump) {
+		std::cout << "\nRENDER METRICS" << std::endl;
+		common::write_metrics_text(std::cout, common::MetricsRegistry::snapshot()) << std::flush;
+	}
+	if (!filename.empty()) {
+		common::Return ret = common::save_metrics(filename);
+		if (!ret.ok()) {
+			std::cerr << "\nError: " << ret << std::endl;
+			return ERROR;
+		}
+	}
+	return SUCCESS;
+}
+
+int outputProfile(const std::string& filename) {
+	if (filename.empty())
+		return SUCCESS;
+	std::ofstream out(filename);
+	if (!out.is_open() || !logging::Profiler::write_chrome_trace(out).flush()) {
+		std::cerr << "\nError: Can't write the profile: '" << filename << "'" << std::endl;
+		return ERROR;
+	}
+	std::cout << "Profile saved: '" << filename << "'" << std::endl;
+	return SUCCESS;
+}
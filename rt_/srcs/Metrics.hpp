@@ -0,0 +1,25 @@
+#ifndef METRICS_HPP
+# define METRICS_HPP
+
+# include <string>
+# include "../../rt/srcs/common/metrics.hpp"
+# include "../../rt/srcs/logging/profiler.hpp"
+
+
+// Render work counters. The renderer counts into the registry of
+// rt/srcs/common/metrics.hpp: rays by kind and intersection tests in
+// Ray::closestScenery, BVH nodes in Bvh::traverse, photon lookups in
+// Ray::phMapLightings, samples in Camera::tracePixel, and passes with their
+// time in Camera::runThreadRoutine. --metrics-dump prints them,
+// --metrics-file=<file.json|file.csv> saves them.
+// Built with -DRT_PROFILE, the render passes, the photon map, the BVH builds,
+// the scene parsing and the saved pictures are profile scopes as well, and
+// --profile=<trace.json> saves them as a Chrome trace.
+using common::Metric;
+using common::metric_add;
+
+int	outputMetrics(bool dump, const std::string& filename);
+int	outputProfile(const std::string& filename);
+
+
+#endif /* METRICS_HPP */
@@ -1,4 +1,5 @@
 #include "MlxImage.hpp"
+#include "Metrics.hpp"
 
 extern Var var;
 
@@ -132,10 +133,15 @@ height(0),
 bytespp(0),
 lineLen(0),
 endian(0),
+headless(false),
 hold(),
 mouseHoldKey(UNHOLD),
 flyby(OFF)
-{}
+{
+# ifdef RT_HEADLESS
+	headless = true;
+# endif
+}
 
 MlxImage::~MlxImage(void) {
 	freePointers();
@@ -157,6 +163,16 @@ int		MlxImage::get_bytespp(void) const { return bytespp; }
 
 int		MlxImage::get_endian(void) const { return endian; }
 
+bool	MlxImage::get_headless(void) const { return headless; }
+
+void	MlxImage::set_headless(bool headless) {
+# ifndef RT_HEADLESS
+	this->headless = headless;
+# else
+	(void)headless;
+# endif
+}
+
 char*	MlxImage::get_pixelAddr(char* data, const Vec2i& v) const {
 	if (!data || v.x < 0 || v.y < 0 || v.x >= width || v.y >= height)
 		return NULL;
@@ -192,6 +208,19 @@ void	MlxImage::init(const std::string& header, const Vec2i& resolution) {
 	width = resolution.x;
 	height = resolution.y;
 
+	if (headless) {
+		bytespp = 4;
+		lineLen = width * bytespp;
+		if ( !(data = (char*)calloc(width * height, bytespp)) ) {
+			int _errno = errno;
+			std::cerr << "Error calloc(): " << strerror(_errno) << std::endl;
+			_exit(*var.img, *var.scene, _errno);
+		}
+		pointers.push(data);
+		(void)header;
+		return;
+	}
+# ifndef RT_HEADLESS
 	if ( !(mlx = mlx_init()) ) {
 		int _errno = errno;
 		std::cerr << "Error mlx_init(): " << strerror(_errno) << std::endl;
@@ -227,6 +256,7 @@ void	MlxImage::init(const std::string& header, const Vec2i& resolution) {
 	mlx_hook(win, ON_MOUSEDOWN, 0, mouseKeyDown, NULL);
 	mlx_hook(win, ON_MOUSEUP, 0, mouseKeyUp, NULL);
 	mlx_hook(win, ON_MOUSEMOVE, 0, mouseMove, NULL);
+# endif
 }
 
 void	MlxImage::freePointers(void) {
@@ -252,6 +282,10 @@ void	MlxImage::mlxToRtXY(Vec2i& v) const {
 // Non-member functions
 
 void	_exit(MlxImage& img, Scene& scene, int code) {
+	if (var.options && outputMetrics(var.options->metricsDump, var.options->metricsFile) != SUCCESS)
+		code = ERROR;
+	if (var.options && outputProfile(var.options->profileFile) != SUCCESS)
+		code = ERROR;
 	img.~MlxImage();
 	scene.~Scene();
 	exit(code);
@@ -321,7 +355,9 @@ int		mouseKeyUp(int button, void* param) {
 int		mouseMove(int button, void* param) {
 	(void)param; (void)button;
 	Vec2i	v;
+# ifndef RT_HEADLESS
 	mlx_mouse_get_pos(var.img->get_win(), &v.x, &v.y);
+# endif
 	if (DEBUG_MOUSE && var.img->isInWinowXY(v)) {
 //		char* pixelAddr = var.img->get_pixelAddr(var.img->get_dataDraw(), v);
 //		Vec2i v1 = var.img->get_XY(var.img->get_dataDraw(), pixelAddr);
@@ -336,6 +372,8 @@ int		mouseMove(int button, void* param) {
 int		flyby(void) {
 	if (var.img->flyby != OFF) {
 		var.scene->flybyCamera();
+	} else {
+		var.scene->refine();
 	}
 	return SUCCESS;
 }
@@ -383,7 +421,7 @@ int		_ARROWS_UP_DOWN(int key) {
 }
 
 int		_ARROWS(int key) {
-	if (_ARROWS_LEFT_RIGHT(key) != ERROR ^ _ARROWS_UP_DOWN(key) != ERROR) {
+	if ((_ARROWS_LEFT_RIGHT(key) != ERROR) ^ (_ARROWS_UP_DOWN(key) != ERROR)) {
 		return key;
 	}
 	return ERROR;
@@ -399,7 +437,7 @@ int		_MINUS_PLUS(int key) {
 }
 
 int		_ARROWS_AND_MINUS_PLUS(int key) {
-	if (_ARROWS(key) != ERROR ^ _MINUS_PLUS(key) != ERROR) {
+	if ((_ARROWS(key) != ERROR) ^ (_MINUS_PLUS(key) != ERROR)) {
 		return key;
 	}
 	return ERROR;
@@ -501,6 +539,7 @@ bool	camerasOptions(int option, bool hold, int val) {
 				case KEY_B:	val = BACKGROUND_LIGHT; break;
 				case KEY_R:	val = RAYTRACING; break;
 				case KEY_P:	val = PATHTRACING; break;
+				case KEY_K:	val = PHOTON_SEARCH; break;
 				default:	return false;
 			}
 		}
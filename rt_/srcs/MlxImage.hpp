@@ -4,7 +4,9 @@
 # include <stack>
 # include "geometry.hpp"
 # include "ARGBColor.hpp"
-# include "mlx.h"
+# ifndef RT_HEADLESS
+#  include "mlx.h"
+# endif
 # include "Scene.hpp"
 # include "Header.h"
 # include "keys.h"
@@ -62,6 +64,7 @@ private:
 	int					bytespp;
 	int					lineLen;
 	int					endian;
+	bool				headless;	// no display: 'data' is a plain buffer, nothing is shown
 public:
 	HoldKeys			hold;
 	int					mouseHoldKey;
@@ -77,6 +80,8 @@ public:
 	int		get_height(void) const;
 	int		get_bytespp(void) const;
 	int		get_endian(void) const;
+	bool	get_headless(void) const;
+	void	set_headless(bool headless);
 	char*	get_pixelAddr(char* data, const Vec2i& v) const;
 	char*	get_pixelAddr(char* data, int x, int y) const;
 	Vec2i	get_XY(char* data, char* addr) const;
@@ -1,4 +1,5 @@
 #include "PhotonMap.hpp"
+#include "Metrics.hpp"
 
 
 // Struct Claster
@@ -69,32 +70,24 @@ bool operator<=(const ClasterKey& left, const ClasterKey& right) {
 }
 
 
-// Struct Claster
-
-Claster::Claster(void) : count(0), traces() {}
-
-Claster::Claster(const Claster& other) : count(other.count), traces(other.traces) {}
-
-Claster::~Claster(void) {}
-
-Claster& Claster::operator=(const Claster& other) {
-	if (this != &other) {
-		count = other.count;
-		traces = other.traces;
-	}
-	return *this;
-}
-
-
 // Class PhotonMap
 
 PhotonMap::PhotonMap(void) :
-clasters_t(),
+_points(),
+_dirs(),
+_pows(),
+_scnrIds(),
+_types(),
+_clasters(),
+_trees(),
+_numClasters(0),
 _sizeGlobal(0),
 _sizeCaustic(0),
 _sizeVolume(0),
 _looped(0),
+_threads(0),
 _time(0),
+_busyRatio(0),
 totalPhotons(0),
 estimate(0),
 gridStep(0),
@@ -103,12 +96,21 @@ type(NO)
 {}
 
 PhotonMap::PhotonMap(const PhotonMap& other) :
-clasters_t(),
-_sizeGlobal(0),
-_sizeCaustic(0),
-_sizeVolume(0),
+_points(other._points),
+_dirs(other._dirs),
+_pows(other._pows),
+_scnrIds(other._scnrIds),
+_types(other._types),
+_clasters(other._clasters),
+_trees{other._trees[0], other._trees[1], other._trees[2]},
+_numClasters(other._numClasters),
+_sizeGlobal(other._sizeGlobal),
+_sizeCaustic(other._sizeCaustic),
+_sizeVolume(other._sizeVolume),
 _looped(0),
+_threads(0),
 _time(0),
+_busyRatio(0),
 totalPhotons(other.totalPhotons),
 estimate(other.estimate),
 gridStep(other.gridStep),
@@ -116,23 +118,31 @@ totalPow(other.totalPow),
 type(other.type)
 {}
 
-PhotonMap::~PhotonMap(void) {
-	deleteTraces();
-}
+PhotonMap::~PhotonMap(void) {}
 
 PhotonMap& PhotonMap::operator=(const PhotonMap& other) {
 	if (this != &other) {
-		deleteTraces();
+		_points = other._points;
+		_dirs = other._dirs;
+		_pows = other._pows;
+		_scnrIds = other._scnrIds;
+		_types = other._types;
+		_clasters = other._clasters;
+		for (int i = 0; i < 3; i++)
+			_trees[i] = other._trees[i];
+		_numClasters = other._numClasters;
+		_sizeGlobal = other._sizeGlobal;
+		_sizeCaustic = other._sizeCaustic;
+		_sizeVolume = other._sizeVolume;
 		_looped = other._looped;
+		_threads = other._threads;
 		_time = other._time;
+		_busyRatio = other._busyRatio;
 		totalPhotons = other.totalPhotons;
 		estimate = other.estimate;
 		gridStep = other.gridStep;
 		totalPow = other.totalPow;
 		type = other.type;
-		for (auto claster = other.begin(), End = other.end(); claster != End; ++claster)
-			for (auto trace = claster->second.traces.begin(), End = claster->second.traces.end(); trace != End;  ++trace)
-				set_trace((*trace)->clone());
 	}
 	return *this;
 }
@@ -144,52 +154,113 @@ int PhotonMap::get_size(MapType type) const {
 		case VOLUME:	return _sizeVolume;
 		default:		break;
 	}
-	return (int)size();
-}
-
-void PhotonMap::swap_(PhotonMap& other) {
-	swap(other);
-	std::swap(_sizeGlobal, other._sizeGlobal);
-	std::swap(_sizeCaustic, other._sizeCaustic);
-	std::swap(_sizeVolume, other._sizeVolume);
-	std::swap(totalPhotons, other.totalPhotons);
-	std::swap(estimate, other.estimate);
-	std::swap(gridStep, other.gridStep);
-	std::swap(totalPow, other.totalPow);
-	std::swap(type, other.type);
+	return size();
 }
 
 void PhotonMap::clear_(void) {
-	if (!empty())
-		clear();
+	_points.clear();
+	_dirs.clear();
+	_pows.clear();
+	_scnrIds.clear();
+	_types.clear();
+	_clasters.clear();
+	for (int i = 0; i < 3; i++)
+		_trees[i] = KdTree();
+	_numClasters = 0;
 	counter(RESET);
 }
 
-void PhotonMap::deleteTraces(void) {
-	for (auto claster = begin(), END = end(); claster != END; ++claster) {
-		for (auto trace = claster->second.traces.begin(), End = claster->second.traces.end(); trace != End;  ++trace) {
-			delete *trace;
-			*trace = NULL;
+// Orders the trace arrays by cell key (stable, so a cell keeps the tracing order of its
+// traces) and rebuilds the cell table.
+void PhotonMap::sortTraces(void) {
+	typedef std::pair<ClasterKey, int> keyIdx_t;
+	ThreadPool& pool = ThreadPool::get();
+	std::vector<keyIdx_t> keys(_points.size());
+	pool.run(keys.size(), PHOTONS_PER_TILE, [&](size_t begin, size_t end){
+		for (size_t i = begin; i < end; i++)
+			keys[i] = keyIdx_t(ClasterKey(_types[i], _points[i], gridStep), (int)i);
+	});
+	pool.sort(keys.begin(), keys.end(), [](const keyIdx_t& l, const keyIdx_t& r){ return l.first < r.first; });
+	std::vector<Vec3f> points(keys.size()), dirs(keys.size());
+	std::vector<Rgb> pows(keys.size());
+	std::vector<int> scnrIds(keys.size());
+	std::vector<MapType> types(keys.size());
+	pool.run(keys.size(), PHOTONS_PER_TILE, [&](size_t begin, size_t end){
+		for (size_t i = begin; i < end; i++) {
+			int j = keys[i].second;
+			points[i] = _points[j];
+			dirs[i] = _dirs[j];
+			pows[i] = _pows[j];
+			scnrIds[i] = _scnrIds[j];
+			types[i] = _types[j];
 		}
+	});
+	_points.swap(points);
+	_dirs.swap(dirs);
+	_pows.swap(pows);
+	_scnrIds.swap(scnrIds);
+	_types.swap(types);
+	_numClasters = 0;
+	for (size_t i = 0, size = keys.size(); i < size; i++)
+		if (i == 0 || keys[i].first != keys[i - 1].first)
+			_numClasters++;
+	size_t tableSize = 1;
+	while (tableSize < 2 * (size_t)_numClasters)	// load factor stays at or below 1/2
+		tableSize <<= 1;
+	std::vector<Claster>(tableSize).swap(_clasters);
+	size_t mask = tableSize - 1;
+	for (size_t begin = 0, end = 0, size = keys.size(); begin < size; begin = end) {
+		for (end = begin + 1; end < size && keys[end].first == keys[begin].first; end++)
+			;
+		size_t slot = keys[begin].first.hash() & mask;
+		while (!_clasters[slot].empty())
+			slot = (slot + 1) & mask;
+		_clasters[slot] = Claster(keys[begin].first, (int)begin, (int)end);
 	}
-	clear_();
+	buildTrees();
 }
 
-void PhotonMap::set_trace(PhotonTrace* trace) {
-	auto it_bool = try_emplace(ClasterKey().make(*trace, gridStep), Claster());
-	it_bool.first->second.add_trace(trace);
-	counter(trace->type);
+// The arrays are sorted by type first, so every tree covers one contiguous range.
+void PhotonMap::buildTrees(void) {
+	ThreadPool::get().run(3, 1, [&](size_t begin, size_t end){
+		for (size_t i = begin; i < end; i++) {
+			MapType type = MapType(CAUSTIC + i);
+			auto first = std::lower_bound(_types.begin(), _types.end(), type);
+			auto last = std::upper_bound(first, _types.end(), type);
+			_trees[i].build(_points, int(first - _types.begin()), int(last - _types.begin()));
+		}
+	});
+}
+
+void PhotonMap::set_traces(phBuffer_t& traces) {
+	size_t size = _points.size() + traces.size();
+	_points.reserve(size);
+	_dirs.reserve(size);
+	_pows.reserve(size);
+	_scnrIds.reserve(size);
+	_types.reserve(size);
+	for (auto trace = traces.begin(), End = traces.end(); trace != End; ++trace) {
+		_points.push_back(trace->pos.p);
+		_dirs.push_back(trace->pos.n);
+		_pows.push_back(trace->pow);
+		_scnrIds.push_back(trace->scnrId);
+		_types.push_back(trace->type);
+		counter(trace->type);
+	}
 }
 
-void PhotonMap::photonPathsTracing_lll(Scenerys& scenerys, phRays_t& rays) {
-	_looped = 0;
-	for (auto ray = rays.begin(), end = rays.end(); ray != end; ++ray) {
-		for(int r = 1; tracePhotonPath(scenerys, *ray, r); r++)
-			if (r >= MAX_PHOTON_COLLISIONS) _looped++;
+int PhotonMap::photonPathsTracing_lll(Scenerys& scenerys, phRays_t& rays, size_t begin, size_t end, phBuffer_t& buffer) {
+	Random& random = localRandom();
+	int looped = 0;
+	for (auto ray = rays.begin() + begin, End = rays.begin() + end; ray != End; ++ray) {
+		random.seed(ray - rays.begin(), 0, PHOTON_MAP_FRAME);
+		for(int r = 1; tracePhotonPath(scenerys, *ray, r, buffer); r++)
+			if (r >= MAX_PHOTON_COLLISIONS) looped++;
 	}
+	return looped;
 }
 
-bool PhotonMap::tracePhotonPath(Scenerys& scenerys, Ray& ray, int r) {
+bool PhotonMap::tracePhotonPath(Scenerys& scenerys, Ray& ray, int r, phBuffer_t& buffer) {
 	if (!ray.photonEnd(scenerys, r)) {
 		HitRecord rec(ray.getNormal(), true);
 		Probability p;
@@ -203,19 +274,21 @@ bool PhotonMap::tracePhotonPath(Scenerys& scenerys, Ray& ray, int r) {
 				ray.pow = rec.pow;
 			ray.pow *= float(1.0 / max);
 			if (choice == DIFFUSION || choice == DIFFUSION_IN_VOLUME)
-				ray.newPhotonTrace(type, rec);
+				ray.newPhotonTrace(type, rec, buffer);
 			return true;
 		}
 		if (p.isDiffusion())
-			ray.newPhotonTrace(type, rec);
+			ray.newPhotonTrace(type, rec, buffer);
 	}
 	return false;
 }
 
 void PhotonMap::make(Scenerys& scenerys, Scenerys& lightsIdx) {
 	if (type != NO) {
+		profile_scope("photon map");
 		auto start = std::chrono::high_resolution_clock::now();
 		phRays_t rays;
+		localRandom().seed(0, 0, PHOTON_MAP_FRAME);
 		auto Begin = lightsIdx.begin(), End = lightsIdx.end();
 		for (auto lightSrc = Begin; lightSrc != End; ++lightSrc)
 			totalPow += (*lightSrc)->get_light();
@@ -224,13 +297,26 @@ void PhotonMap::make(Scenerys& scenerys, Scenerys& lightsIdx) {
 			int n = (*lightSrc)->get_light().get_maxBand() / totalPow.get_maxBand() * totalPhotons;
 			(*lightSrc)->photonEmissions(n, rays);
 		}
-		photonPathsTracing_lll(scenerys, rays);
-		deleteTraces();
-		for (auto ray = rays.begin(), end = rays.end(); ray != end; ++ray) {
-			for (auto trace = ray->traces.begin(), end = ray->traces.end(); trace != end; ++trace) {
-				set_trace(*trace);
-			}
-		}
+		ThreadPool& pool = ThreadPool::get();
+		std::vector<phBuffer_t> buffers((rays.size() + PHOTONS_PER_TILE - 1) / PHOTONS_PER_TILE);
+		std::atomic<int> looped(0);
+		std::atomic<long> busy(0);	// tracing time summed over tiles, ns
+		auto tracingStart = std::chrono::steady_clock::now();
+		pool.run(rays.size(), PHOTONS_PER_TILE, [&](size_t begin, size_t end){
+			auto tileStart = std::chrono::steady_clock::now();
+			looped += photonPathsTracing_lll(scenerys, rays, begin, end, buffers[begin / PHOTONS_PER_TILE]);
+			busy += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tileStart).count();
+		});
+		long wall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tracingStart).count();
+		_busyRatio = wall ? float(busy) / wall : 1;	// threads kept busy on average, not a speedup
+		_threads = (int)pool.get_size();
+		_looped = looped;
+		clear_();
+		phRays_t().swap(rays);
+		for (auto buffer = buffers.begin(), end = buffers.end(); buffer != end; ++buffer)
+			set_traces(*buffer);
+		std::vector<phBuffer_t>().swap(buffers);
+		sortTraces();
 		auto end = std::chrono::high_resolution_clock::now();
 		std::chrono::duration<double> duration = end - start;
 		_time = duration.count();
@@ -238,20 +324,6 @@ void PhotonMap::make(Scenerys& scenerys, Scenerys& lightsIdx) {
 	}
 }
 
-void PhotonMap::lookat(const Position& eye, const LookatAux& aux, float roll) {
-	if (type != NO) {
-		PhotonMap tmp(*this);
-		for (auto claster = begin(), End = end(); claster != End; ++claster) {
-			for (auto trace = claster->second.traces.begin(), end = claster->second.traces.end(); trace != end;  ++trace) {
-				(*trace)->pos.lookat(eye, aux, roll);
-				tmp.set_trace(*trace);
-			}
-		}
-		swap_(tmp);
-		tmp.clear_();
-	}
-}
-
 void PhotonMap::outputPhotonMapParametrs(void) {
 	if (type == NO) return;
 	std::cout << "\nPHOTON MAP" << std::endl;
@@ -262,13 +334,14 @@ void PhotonMap::outputPhotonMapParametrs(void) {
 	std::cout << "Photon traces maps:"   << std::endl;
 	if (_looped)
 		std::cout << "!>looped photons....." << _looped << std::endl;
-	std::cout << "  clasters..........." << size() << std::endl;
+	std::cout << "  clasters..........." << _numClasters << std::endl;
 	if (_sizeCaustic)
 		std::cout << "  caustic traces....." << _sizeCaustic << std::endl;
 	if (_sizeGlobal)
 		std::cout << "  global traces......" << _sizeGlobal << std::endl;
 	if (_sizeVolume)
 		std::cout << "  volume traces......" << _sizeVolume << std::endl;
+	std::cout << "  busy/wall time....." << roundedString(_busyRatio, 2) << " of " << _threads << " threads" << std::endl;
 	std::cout << "  elapsed time......." << roundedString(_time, 4) << "sec\n" << std::endl;
 }
 
@@ -1,10 +1,12 @@
 #ifndef PHOTONMAP_HPP
 # define PHOTONMAP_HPP
 
-# include <map>
-# include <forward_list>
+# include <vector>
+# include <cstdint>
 # include "Ray.hpp"
 # include "A_Scenery.hpp"
+# include "ThreadPool.hpp"
+# include "KdTree.hpp"
 
 struct	Ray;
 struct	Rays;
@@ -14,7 +16,7 @@ struct	PhotonTrace;
 typedef	Rays phRays_t;
 
 
-typedef std::forward_list<PhotonTrace*> phTraces_t;
+typedef std::vector<PhotonTrace> phBuffer_t;
 
 struct ClasterKey {
 	MapType	type;
@@ -28,6 +30,13 @@ struct ClasterKey {
 	ClasterKey& operator=(const ClasterKey& other);
 	ClasterKey&	make(MapType _type, const Vec3f& point, float gridStep);
 	ClasterKey&	make(const PhotonTrace& trace, float gridStep);
+	inline size_t hash(void) const {
+		uint64_t h = (uint64_t)(uint32_t)type;
+		h = (h ^ (uint32_t)x) * 0x9E3779B97F4A7C15ULL;
+		h = (h ^ (uint32_t)y) * 0x9E3779B97F4A7C15ULL;
+		h = (h ^ (uint32_t)z) * 0x9E3779B97F4A7C15ULL;
+		return (size_t)(h ^ (h >> 32));
+	}
 	friend bool operator==(const ClasterKey& left, const ClasterKey& right);
 	friend bool operator!=(const ClasterKey& left, const ClasterKey& right);
 	friend bool operator<(const ClasterKey& left, const ClasterKey& right);
@@ -38,26 +47,44 @@ struct ClasterKey {
 };
 
 
+// struct Claster
+// Contiguous range of the traces of one grid cell, slot of the open-addressing
+// cell table (a free slot has an empty range).
 struct Claster {
-	int			count;
-	phTraces_t	traces;
-	Claster(void);
-	Claster(const Claster& other);
-	~Claster(void);
-	Claster& operator=(const Claster& other);
-	inline void add_trace(PhotonTrace* trace) {
-		traces.emplace_front(trace);
-		count++;
+	ClasterKey	key;
+	int			begin;
+	int			end;
+	Claster(void) : key(), begin(0), end(0) {}
+	Claster(const ClasterKey& key, int begin, int end) : key(key), begin(begin), end(end) {}
+	Claster(const Claster& other) : key(other.key), begin(other.begin), end(other.end) {}
+	~Claster(void) {}
+	Claster& operator=(const Claster& other) {
+		if (this != &other) {
+			key = other.key;
+			begin = other.begin;
+			end = other.end;
+		}
+		return *this;
 	}
+	inline bool empty(void) const { return begin == end; }
 };
+// struct Claster end
 
 
-typedef std::map<ClasterKey,Claster>	clasters_t;
-
-
-class PhotonMap : public clasters_t {
-	int _sizeGlobal, _sizeCaustic, _sizeVolume, _looped;
-	float _time;
+// class PhotonMap
+// Photon traces are kept sorted by cell key in parallel arrays (one per field), so
+// the traces of a cell are a contiguous range and a neighbourhood query is a few
+// range scans. Cells are found through an open-addressing hash table.
+class PhotonMap {
+	std::vector<Vec3f>		_points;
+	std::vector<Vec3f>		_dirs;
+	std::vector<Rgb>		_pows;
+	std::vector<int>		_scnrIds;
+	std::vector<MapType>	_types;
+	std::vector<Claster>	_clasters;	// hash table, its size is a power of 2
+	KdTree					_trees[3];	// CAUSTIC, GLOBAL and VOLUME traces
+	int _numClasters, _sizeGlobal, _sizeCaustic, _sizeVolume, _looped, _threads;
+	float _time, _busyRatio;
 public:
 	int		totalPhotons;
 	int		estimate;
@@ -70,12 +97,12 @@ public:
 	PhotonMap& operator=(const PhotonMap& other);
 private:
 	int  get_size(MapType type) const;
-	void swap_(PhotonMap& other);
 	void clear_(void);
-	void deleteTraces(void);
-	void set_trace(PhotonTrace* trace);
-	void photonPathsTracing_lll(Scenerys& scenerys, phRays_t& rays);
-	bool tracePhotonPath(Scenerys& scenerys, Ray& ray, int r);
+	void sortTraces(void);
+	void buildTrees(void);
+	void set_traces(phBuffer_t& traces);
+	int  photonPathsTracing_lll(Scenerys& scenerys, phRays_t& rays, size_t begin, size_t end, phBuffer_t& buffer);
+	bool tracePhotonPath(Scenerys& scenerys, Ray& ray, int r, phBuffer_t& buffer);
 	inline void counter(MapType type) {
 		switch (type) {
 			case GLOBAL:	_sizeGlobal++; return;
@@ -85,35 +112,61 @@ private:
 		}
 		_sizeGlobal = _sizeCaustic = _sizeVolume = 0;
 	}
-	inline void get_traces(const ClasterKey& key, phTraces_t& traces) const {
-		auto search = find(key);
-		if (search != end()) {
-			traces.insert_after(traces.before_begin(), search->second.traces.begin(), search->second.traces.end());
+	inline const Claster* find(const ClasterKey& key) const {
+		if (_clasters.empty())
+			return NULL;
+		size_t mask = _clasters.size() - 1;
+		for (size_t i = key.hash() & mask;; i = (i + 1) & mask) {
+			if (_clasters[i].empty())
+				return NULL;
+			if (_clasters[i].key == key)
+				return &_clasters[i];
 		}
 	}
 public:
-	inline float get_sqr(void) const { return gridStep * gridStep; }
-	inline void get_traces(const Vec3f& point, phTraces_t& traces, MapType type) const {
-		if (!traces.empty()) traces.clear();
+	inline float		get_sqr(void) const { return gridStep * gridStep; }
+	inline int			size(void) const { return (int)_points.size(); }
+	inline const Vec3f&	get_point(int i) const { return _points[i]; }
+	inline const Vec3f&	get_dir(int i) const { return _dirs[i]; }
+	inline const Rgb&	get_pow(int i) const { return _pows[i]; }
+	inline int			get_scnrId(int i) const { return _scnrIds[i]; }
+	inline float		get_time(void) const { return _time; }	// seconds the last make() took
+	// Calls visit(i) for every trace of the type in the 27 cells around the point and
+	// returns false if all of them are empty. Cells that differ only in z follow each
+	// other in the arrays, so every column of three cells is scanned as one range.
+	template <class Visit>
+	bool get_traces27(const Vec3f& point, MapType type, Visit visit) const {
 		ClasterKey	key(type, point, gridStep);
-		get_traces(key, traces);
-	}
-	inline void get_traces27(const Vec3f& point, phTraces_t& traces, MapType type) const {
-		if (!traces.empty()) traces.clear();
-		ClasterKey	key(type, point, gridStep);
-		int x_begin = key.x - 1, x_end = key.x + 2;
-		int y_begin = key.y - 1, y_end = key.y + 2;
-		int z_begin = key.z - 1, z_end = key.z + 2;
-		for (key.x = x_begin; key.x < x_end; key.x++)
-			for (key.y = y_begin; key.y < y_end; key.y++)
-				for (key.z = z_begin; key.z < z_end; key.z++) {
-					get_traces(key, traces);
+		int x = key.x, y = key.y, z = key.z;
+		bool found = false;
+		for (key.x = x - 1; key.x <= x + 1; key.x++)
+			for (key.y = y - 1; key.y <= y + 1; key.y++) {
+				int begin = 0, end = 0;
+				for (key.z = z - 1; key.z <= z + 1; key.z++) {
+					const Claster* claster = find(key);
+					if (claster) {
+						if (begin == end)
+							begin = claster->begin;
+						end = claster->end;
+					}
 				}
+				found = found || begin != end;
+				for (int i = begin; i < end; i++)
+					visit(i);
+			}
+		return found;
+	}
+	// k-nearest traces of the type from the kd-tree, see KdTree::nearest
+	template <class Accept>
+	int get_nearest(const Vec3f& point, MapType type, float radius, int k, KdTree::Neighbour* nearest, Accept accept) const {
+		if (type == NO || type == RESET)
+			return 0;
+		return _trees[type - CAUSTIC].nearest(point, radius, k, nearest, accept);
 	}
 	void make(Scenerys& scenerys, Scenerys& lightsIdx);
-	void lookat(const Position& eye, const LookatAux& aux, float roll);
 	void outputPhotonMapParametrs(void);
 };
+// class PhotonMap end
 
 
 #endif /* PHOTONMAP_HPP */
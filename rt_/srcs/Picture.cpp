@@ -0,0 +1,226 @@
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include "Picture.hpp"
+#include "Metrics.hpp"
+
+
+// Non member functions
+
+static std::string extension(const std::string& filename) {
+	size_t dot = filename.rfind('.');
+	std::string ext = dot == std::string::npos ? "" : filename.substr(dot + 1);
+	for (auto& c : ext)
+		c = std::tolower(c);
+	return ext;
+}
+
+PictureFormat pictureFormat(const std::string& filename) {
+	std::string ext = extension(filename);
+	if (ext == "ppm")
+		return PPM;
+	if (ext == "png")
+		return PNG;
+	if (ext == "pfm")
+		return PFM;
+	if (ext == "exr")
+		return EXR;
+	return UNKNOWN_FORMAT;
+}
+
+static void rgb8(const Rgb& pixel, float gamma, unsigned char* out) {
+	int rgba = pixel.get_rgba(gamma);
+	out[0] = 0xFF & (rgba >> 16);
+	out[1] = 0xFF & (rgba >> 8);
+	out[2] = 0xFF & rgba;
+}
+
+static void put32le(std::string& s, uint32_t v) {
+	for (int i = 0; i < 4; i++)
+		s += char(0xFF & (v >> (8 * i)));
+}
+
+static void put32be(std::string& s, uint32_t v) {
+	for (int i = 3; i >= 0; i--)
+		s += char(0xFF & (v >> (8 * i)));
+}
+
+static void putFloat(std::string& s, float f) {
+	uint32_t v;
+	std::memcpy(&v, &f, sizeof(v));
+	put32le(s, v);
+}
+
+void writePpm(std::ofstream& out, int width, int height, const std::vector<Rgb>& pixels, float gamma) {
+	std::vector<unsigned char> row(3 * width);
+	out << "P6\n" << width << " " << height << "\n255\n";
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++)
+			rgb8(pixels[y * width + x], gamma, &row[3 * x]);
+		out.write((const char*)row.data(), row.size());
+	}
+}
+
+static uint32_t crc32(const std::string& data, size_t begin) {
+	static uint32_t table[256];
+	if (table[1] == 0) {
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+	}
+	uint32_t c = 0xFFFFFFFFu;
+	for (size_t i = begin; i < data.size(); i++)
+		c = table[(c ^ (unsigned char)data[i]) & 0xFF] ^ (c >> 8);
+	return c ^ 0xFFFFFFFFu;
+}
+
+static void pngChunk(std::ofstream& out, const char* type, const std::string& data) {
+	std::string chunk;
+	put32be(chunk, (uint32_t)data.size());
+	chunk += type;
+	chunk += data;
+	put32be(chunk, crc32(chunk, 4));
+	out.write(chunk.data(), chunk.size());
+}
+
+// Scanlines go into stored (uncompressed) deflate blocks: no zlib on the render nodes.
+void writePng(std::ofstream& out, int width, int height, const std::vector<Rgb>& pixels, float gamma) {
+	std::string raw;
+	raw.reserve((3 * width + 1) * height);
+	unsigned char rgb[3];
+	for (int y = 0; y < height; y++) {
+		raw += char(0);	// filter type None
+		for (int x = 0; x < width; x++) {
+			rgb8(pixels[y * width + x], gamma, rgb);
+			raw.append((const char*)rgb, 3);
+		}
+	}
+	std::string ihdr, idat("\x78\x01", 2);
+	put32be(ihdr, width);
+	put32be(ihdr, height);
+	ihdr += std::string("\x08\x02\x00\x00\x00", 5);	// 8-bit RGB, deflate, no interlace
+	uint32_t a = 1, b = 0;
+	for (size_t pos = 0, len; pos < raw.size(); pos += len) {
+		len = std::min(raw.size() - pos, (size_t)0xFFFF);
+		idat += char(pos + len == raw.size());
+		idat += char(len & 0xFF);
+		idat += char(len >> 8);
+		idat += char(~len & 0xFF);
+		idat += char((~len >> 8) & 0xFF);
+		idat.append(raw, pos, len);
+		for (size_t i = pos; i < pos + len; i++) {
+			a = (a + (unsigned char)raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+	}
+	put32be(idat, (b << 16) | a);
+	out.write("\x89PNG\r\n\x1A\n", 8);
+	pngChunk(out, "IHDR", ihdr);
+	pngChunk(out, "IDAT", idat);
+	pngChunk(out, "IEND", "");
+}
+
+// Rows bottom to top, little-endian (negative scale).
+void writePfm(std::ofstream& out, int width, int height, const std::vector<Rgb>& pixels) {
+	std::string row;
+	out << "PF\n" << width << " " << height << "\n-1.0\n";
+	for (int y = height - 1; y >= 0; y--) {
+		row.clear();
+		for (int x = 0; x < width; x++) {
+			const Rgb& pixel = pixels[y * width + x];
+			putFloat(row, pixel.get_band(2));
+			putFloat(row, pixel.get_band(1));
+			putFloat(row, pixel.get_band(0));
+		}
+		out.write(row.data(), row.size());
+	}
+}
+
+static void exrAttribute(std::string& s, const char* name, const char* type, const std::string& value) {
+	s += name; s += char(0);
+	s += type; s += char(0);
+	put32le(s, (uint32_t)value.size());
+	s += value;
+}
+
+// Single-part scanline file, uncompressed FLOAT channels B, G, R (alphabetical, as
+// the format requires), one scanline per block.
+void writeExr(std::ofstream& out, int width, int height, const std::vector<Rgb>& pixels) {
+	std::string header("\x76\x2f\x31\x01\x02\x00\x00\x00", 8), value;
+	for (const char* name : {"B", "G", "R"}) {
+		value += name; value += char(0);
+		put32le(value, 2);				// FLOAT
+		value += std::string(4, 0);		// pLinear, reserved
+		put32le(value, 1);				// x and y sampling
+		put32le(value, 1);
+	}
+	value += char(0);
+	exrAttribute(header, "channels", "chlist", value);
+	exrAttribute(header, "compression", "compression", std::string(1, 0));
+	value.clear();
+	put32le(value, 0); put32le(value, 0); put32le(value, width - 1); put32le(value, height - 1);
+	exrAttribute(header, "dataWindow", "box2i", value);
+	exrAttribute(header, "displayWindow", "box2i", value);
+	exrAttribute(header, "lineOrder", "lineOrder", std::string(1, 0));
+	value.clear(); putFloat(value, 1);
+	exrAttribute(header, "pixelAspectRatio", "float", value);
+	value.clear(); putFloat(value, 0); putFloat(value, 0);
+	exrAttribute(header, "screenWindowCenter", "v2f", value);
+	value.clear(); putFloat(value, 1);
+	exrAttribute(header, "screenWindowWidth", "float", value);
+	header += char(0);
+
+	uint32_t lineSize = 3 * 4 * width;
+	uint64_t offset = header.size() + 8 * (uint64_t)height;
+	for (int y = 0; y < height; y++, offset += 8 + lineSize) {
+		put32le(header, (uint32_t)offset);
+		put32le(header, (uint32_t)(offset >> 32));
+	}
+	out.write(header.data(), header.size());
+	std::string line;
+	for (int y = 0; y < height; y++) {
+		line.clear();
+		put32le(line, y);
+		put32le(line, lineSize);
+		for (int band = 0; band < 3; band++)	// Rgb bands are b, g, r
+			for (int x = 0; x < width; x++)
+				putFloat(line, pixels[y * width + x].get_band(band));
+		out.write(line.data(), line.size());
+	}
+}
+
+int savePicture(const std::string& filename, int width, int height, const std::vector<Rgb>& pixels, float gamma) {
+	profile_scope("save picture");
+	PictureFormat format = pictureFormat(filename);
+	if (format == UNKNOWN_FORMAT) {
+		std::cerr	<< "\nWarning: Unknown picture format: '" << filename
+					<< "'. Use *.ppm, *.png, *.pfm or *.exr" << std::endl;
+		return ERROR;
+	}
+	std::ofstream out(filename, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (out.fail()) {
+		int error = errno;
+		std::cerr	<< "\nWarning: Can't open file: "
+					<< "'" << filename << "'. "
+					<< strerror(error) << std::endl;
+		return error;
+	}
+	switch (format) {
+		case PPM: writePpm(out, width, height, pixels, gamma); break;
+		case PNG: writePng(out, width, height, pixels, gamma); break;
+		case PFM: writePfm(out, width, height, pixels); break;
+		case EXR: writeExr(out, width, height, pixels); break;
+		default: break;
+	}
+	out.close();
+	if (out.fail()) {
+		int error = errno;
+		std::cerr << "\nWarning: Can't write file: '" << filename << "'. " << strerror(error) << std::endl;
+		return error ? error : ERROR;
+	}
+	return SUCCESS;
+}
@@ -0,0 +1,28 @@
+#ifndef PICTURE_HPP
+# define PICTURE_HPP
+
+# include <string>
+# include <vector>
+# include <fstream>
+# include "Rgb.hpp"
+# include "Header.h"
+
+// Offline output of a rendered frame. PPM and PNG are 8-bit with gamma applied
+// like the window image, PFM and EXR keep the linear float radiance.
+enum PictureFormat { PPM, PNG, PFM, EXR, UNKNOWN_FORMAT };
+
+
+// Non member functions
+
+PictureFormat	pictureFormat(const std::string& filename);
+void	writePpm(std::ofstream& out, int width, int height, const std::vector<Rgb>& pixels, float gamma);
+void	writePng(std::ofstream& out, int width, int height, const std::vector<Rgb>& pixels, float gamma);
+void	writePfm(std::ofstream& out, int width, int height, const std::vector<Rgb>& pixels);
+void	writeExr(std::ofstream& out, int width, int height, const std::vector<Rgb>& pixels);
+
+// 'pixels' go row by row from the upper left corner. Returns SUCCESS, or errno /
+// ERROR after printing a warning.
+int		savePicture(const std::string& filename, int width, int height, const std::vector<Rgb>& pixels, float gamma = GAMMA);
+
+
+#endif /* PICTURE_HPP */
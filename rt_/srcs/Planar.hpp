@@ -30,17 +30,12 @@ public:
 		if (ray.hit == INSIDE)
 			ray.norm.product(-1);
 	}
-	inline void  lookat(const Position& eye, const LookatAux& aux, const Vec3f& pos, float roll) {
-		(void)pos;
-		_planar->lookat(eye, aux, roll);
-	}
-	inline void  roll(const Vec3f& pos, float roll) {
-		(void)pos;
-		_planar->roll(roll);
-	}
 	inline bool  intersection(Ray& ray) {
 		return _planar->intersection(ray.pov, ray.dir, ray.dist, ray.intersections.a.d, ray.intersections.b.d, ray.hit);
 	}
+	inline bool  getBounds(Aabb& box) const {
+		return _planar->bounds(box);
+	}
 	inline float lighting(Ray& ray) const {
 		(void)ray;
 		return 0;
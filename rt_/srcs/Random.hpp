@@ -0,0 +1,54 @@
+#ifndef RANDOM_HPP
+# define RANDOM_HPP
+
+# include <cstdint>
+
+
+// PCG32 generator (O'Neill, pcg-random.org) keyed by a counter triple.
+// seed(pixel, sample, frame) hashes the key into the initial state and picks
+// an independent stream for every pixel, so the sequence drawn for a sample
+// does not depend on which thread traces it or in which order.
+class Random {
+	uint64_t	_state;
+	uint64_t	_inc;
+	static inline uint64_t mix(uint64_t x) {	// splitmix64 finalizer
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+public:
+	Random(void) : _state(0x853C49E6748FEA9BULL), _inc(0xDA3E39CB94B95BDBULL) {}
+	Random(uint64_t pixel, uint64_t sample, uint64_t frame) : _state(0), _inc(0) { seed(pixel, sample, frame); }
+	Random(const Random& other) : _state(other._state), _inc(other._inc) {}
+	~Random(void) {}
+	Random& operator=(const Random& other) {
+		if (this != &other) {
+			_state = other._state;
+			_inc = other._inc;
+		}
+		return *this;
+	}
+	inline Random& seed(uint64_t pixel, uint64_t sample, uint64_t frame) {
+		_state = 0;
+		_inc = (mix(pixel) << 1) | 1u;
+		next();
+		_state += mix(sample ^ mix(frame));
+		next();
+		return *this;
+	}
+	inline uint32_t next(void) {
+		uint64_t old = _state;
+		_state = old * 6364136223846793005ULL + _inc;
+		uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+		uint32_t rot = (uint32_t)(old >> 59u);
+		return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+	}
+	inline double get_double(void) { return next() * (1.0 / 4294967296.0); }	// [0, 1)
+	inline double unitCoordinate(void) { return get_double() * 2.0 - 1.0; }		// [-1, 1)
+};
+
+Random&	localRandom(void);	// generator of the calling thread
+
+
+#endif /* RANDOM_HPP */
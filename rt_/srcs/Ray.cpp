@@ -1,4 +1,6 @@
 #include "Ray.hpp"
+#include "Light.hpp"
+#include "Metrics.hpp"
 
 
 // struct HitRecord
@@ -21,17 +23,6 @@ hit(FRONT),
 scnr(NULL)
 {}
 
-HitRecord::~HitRecord(void) {}
-
-HitRecord::HitRecord(const HitRecord& other) :
-paint(other.paint),
-pov(other.pov),
-dir(other.dir),
-norm(other.norm),
-hit(other.hit),
-scnr(other.scnr)
-{}
-
 HitRecord::HitRecord(Ray& ray, bool photon) :
 paint(),
 pov(ray.pov),
@@ -46,18 +37,6 @@ scnr(ray.scnr)
 		ray.paint.reset();
 }
 
-HitRecord& HitRecord::operator=(const HitRecord& other) {
-	if (this != &other) {
-		paint = other.paint;
-		pov = other.pov;
-		dir = other.dir;
-		norm = other.norm;
-		hit = other.hit;
-		scnr = other.scnr;
-	}
-	return *this;
-}
-
 
 // Struct PhotonTrace
 
@@ -98,9 +77,7 @@ recursion(0),
 dist(0),
 path(),
 intersections(),
-combineType(END),
-segments(),
-traces()
+combineType(END)
 {}
 
 Ray::Ray(const Rgb& pow, const Vec3f& pov, int r) :
@@ -109,9 +86,7 @@ recursion(r),
 dist(0),
 path(),
 intersections(),
-combineType(END),
-segments(),
-traces()
+combineType(END)
 {}
 
 Ray::Ray(const Position pos, const Rgb& _pow) :
@@ -120,9 +95,7 @@ recursion(1),
 dist(0),
 path(),
 intersections(),
-combineType(END),
-segments(),
-traces()
+combineType(END)
 {
 	pow = _pow;
 	pov = pos.p;
@@ -135,38 +108,13 @@ recursion(1),
 dist(0),
 path(),
 intersections(),
-combineType(END),
-segments(),
-traces()
+combineType(END)
 {
 	pow = _pow;
 	pov = pos.p;
 	dir.randomInUnitHemisphereCosineDistribution(aux);
 }
 
-Ray::~Ray(void) {}
-
-Ray::Ray(const Ray& other) { *this = other; }
-
-Ray& Ray::operator=(const Ray& other) {
-	if (this != & other) {
-		paint = other.paint;
-		pov = other.pov;
-		dir = other.dir;
-		norm = other.norm;
-		hit = other.hit;
-		recursion = other.recursion;
-		dist = other.dist;
-		pow = other.pow;
-		path = other.path;
-		intersections = other.intersections;
-		combineType = other.combineType;
-		segments = other.segments;
-		traces = other.traces;
-	}
-	return *this;
-}
-
 Ray& Ray::operator=(const HitRecord& other) {
 	if (this != & other) {
 		paint = other.paint;
@@ -208,14 +156,16 @@ Ray& Ray::getNormal(void) {
 }
 
 Ray& Ray::combination(void) {
-	for (auto segment = segments.begin(), end = segments.end(); segment != end; ++segment) {
-		if (segment->removed || !segment->combine) {
+	Segments& segments = localSegments();
+	for (int i = (int)segments.size() - 1; i >= 0; i--) {	// newest first, segments added meanwhile are skipped
+		Segment& segment = segments[i];
+		if (segment.removed || !segment.combine) {
 			continue;
 		}
 		switch (combineType) {
-			case UNION:			union_(*segment, intersections); break;
-			case SUBTRACTION:	subtraction(*segment, intersections); break;
-			case INTERSECTION:	intersection(*segment, intersections); break;
+			case UNION:			union_(segment, intersections); break;
+			case SUBTRACTION:	subtraction(segment, intersections); break;
+			case INTERSECTION:	intersection(segment, intersections); break;
 			default: break;
 		}
 	}
@@ -254,14 +204,16 @@ Ray& Ray::subtraction(Segment& segment1, Segment& segment2) {
 		if (segment1.a.d > segment2.b.d || segment2.a.d > segment1.b.d) {
 			return *this;
 		}
-		if (segment1.a.d < segment2.a.d) {
-			emplace(segment1.a, segment2.a, true);
-		}
+		Point a(segment1.a);
+		bool split = segment1.a.d < segment2.a.d;
 		if (segment1.b.d > segment2.b.d) {
 			segment1.a = segment2.b;
 		} else {
 			segment1.removed = true;
 		}
+		if (split) {	// last: emplace may move segment1
+			emplace(a, segment2.a, true);
+		}
 	} else if (segment1.empty() && !segment2.empty()) {	// ∅ – a2 = ∅
 		segment1.removed = true;
 //	} else if (!segment1.empty() && segment2.empty()) {	// a1 – ∅ = a1
@@ -329,57 +281,92 @@ Ray& Ray::fakeAmbientLighting(HitRecord& rec, const Rgb& ambient) {
 	return *this;
 }
 
-Ray& Ray::directLightings(HitRecord& rec, const Scenerys& scenerys, const Scenerys& lightsIdx) {
+// A shadow ray to each of the 'lights' if there are at most 'shadowRays' of them, else
+// 'shadowRays' ones picked by power, each weighted by the inverse of its expected count
+Ray& Ray::directLightings(HitRecord& rec, const Scenerys& scenerys, const LightPicker& lights, int shadowRays) {
+	if (rec.scnr->diffusion || rec.scnr->get_glossy()) {
+		if (!lights.isPicking(shadowRays)) {
+			for (auto light = lights.begin(), end = lights.end(); light != end; ++light)
+				directLighting(rec, scenerys, **light, 1);
+		} else {
+			for (int i = 0; i < shadowRays; i++) {
+				int l = lights.sample(random_double());
+				directLighting(rec, scenerys, *lights[l], 1 / (shadowRays * lights.pick[l]));
+			}
+		}
+	}
+	return *this;
+}
+
+Ray& Ray::directLighting(HitRecord& rec, const Scenerys& scenerys, const Light& light, float weight) {
 	float diffusion = rec.scnr->diffusion;
 	float glossy = rec.scnr->get_glossy();
-	if (diffusion || glossy) {
-		for (auto lightSrc = lightsIdx.begin(); lightSrc != lightsIdx.end(); ++lightSrc) {
-			float lighting = (*lightSrc)->lighting(*this);
-			if (lighting > 0) {
-				movePovByNormal(EPSILON);
-				if (!closestScenery(scenerys, dist - 2 * EPSILON, ANY_SHADOW)) {
-					if (glossy) {
-						float shining = getShining_(rec.dir, rec.norm, dir, glossy);
-						if (shining > _1_255)
-							rec.paint += (paint * shining);
-					}
-					if ((lighting *= diffusion) > 0)
-						rec.paint += paint.attenuate(rec.scnr->getColor(rec), lighting);
-				}
+	float lighting = light.lighting(*this);
+	if (lighting > 0) {
+		movePovByNormal(EPSILON);
+		if (!closestScenery(scenerys, dist - 2 * EPSILON, ANY_SHADOW)) {
+			if (glossy) {
+				float shining = getShining_(rec.dir, rec.norm, dir, glossy);
+				if (shining > _1_255)
+					rec.paint += (paint * shining) *= weight;
 			}
-			restore(rec);
+			if ((lighting *= diffusion) > 0)
+				rec.paint += paint.attenuate(rec.scnr->getColor(rec), lighting) *= weight;
 		}
 	}
+	restore(rec);
 	return *this;
 }
 
-Ray& Ray::phMapLightings(HitRecord& rec, const PhotonMap& phMap, MapType type) {
+bool Ray::gridTraces(HitRecord& rec, const PhotonMap& phMap, MapType type, TraceAround* nearest, int& n) {
+	static thread_local std::vector<TraceAround> around;	// keeps its capacity between calls
+	around.clear();
+	float radius = phMap.gridStep * 0.5;
+	int scnrId = rec.scnr->get_id();
+	bool found = phMap.get_traces27(pov, type, [&](int i){
+		if (phMap.get_scnrId(i) == scnrId) {
+			float distance = (rec.pov - phMap.get_point(i)).norm();
+			if (distance <= radius) {
+				float fading = -(phMap.get_dir(i) * rec.norm);
+				if (fading > 0)
+					around.push_back(TraceAround(distance, fading, i));
+			}
+		}
+	});
+	std::sort(around.begin(), around.end());
+	around.erase(std::unique(around.begin(), around.end(), [](const TraceAround& l, const TraceAround& r){
+		return l.distance == r.distance;
+	}), around.end());	// one trace per distance
+	n = std::min((int)around.size(), phMap.estimate + 1);
+	std::copy(around.begin(), around.begin() + n, nearest);
+	return found;
+}
+
+bool Ray::kdTreeTraces(HitRecord& rec, const PhotonMap& phMap, MapType type, TraceAround* nearest, int& n) {
+	KdTree::Neighbour heap[MAX_ESTIMATE_PHOTONS + 1];
+	int scnrId = rec.scnr->get_id();
+	n = phMap.get_nearest(rec.pov, type, phMap.gridStep * 0.5, phMap.estimate + 1, heap, [&](int i){
+		return phMap.get_scnrId(i) == scnrId && -(phMap.get_dir(i) * rec.norm) > 0;
+	});
+	for (int i = 0; i < n; i++)
+		nearest[i] = TraceAround(std::sqrt(heap[i].sqrDistance), -(phMap.get_dir(heap[i].trace) * rec.norm), heap[i].trace);
+	return n > 0;
+}
+
+Ray& Ray::phMapLightings(HitRecord& rec, const PhotonMap& phMap, MapType type, PhotonSearch search) {
 	float diffusion = rec.scnr->diffusion;
 	if (diffusion) {
-		phMap.get_traces27(pov, traces, type);
-		if (!traces.empty()) {
-			std::map<float, TraceAround> sortedTraces;
-			float radius = phMap.gridStep * 0.5;
-			int scnrId = rec.scnr->get_id(), estimate = phMap.estimate;
-			for (auto trace = traces.begin(), end = traces.end(); trace != end; ++trace) {
-				if ((*trace)->scnrId == scnrId) {
-					float distance = (rec.pov - (*trace)->pos.p).norm();
-					if (distance <= radius) {
-						float fading = -((*trace)->pos.n * rec.norm);
-						if (fading > 0)
-							sortedTraces.emplace(distance, TraceAround(fading, *trace));
-					}
-				}
-			}
-			if (!traces.empty()) traces.clear();
-			int n = 0;
-			auto it = sortedTraces.begin(), last = sortedTraces.begin(), End = sortedTraces.end();
-			for (; it != End && n <= estimate; ++it, n++)
-				last = it;
-			float maxR = last->first;
-			for (it = sortedTraces.begin(), n = 0; it != End && n <= estimate; ++it, n++) {
-				float w = 1. - it->first / (maxR * CONE_FILTER_COEFFICIENT);
-				pow += Rgb(it->second.trace->pow).attenuate(-1, it->second.fading * w);
+		metric_add(Metric::PhotonLookups);
+		TraceAround	nearest[MAX_ESTIMATE_PHOTONS + 1];	// ascending distances
+		int n = 0;
+		bool found = search == KDTREE_SEARCH ?
+			kdTreeTraces(rec, phMap, type, nearest, n) :
+			gridTraces(rec, phMap, type, nearest, n);
+		if (found) {
+			float maxR = n ? nearest[n - 1].distance : 0;
+			for (int i = 0; i < n; i++) {
+				float w = 1. - nearest[i].distance / (maxR * CONE_FILTER_COEFFICIENT);
+				pow += Rgb(phMap.get_pow(nearest[i].trace)).attenuate(-1, nearest[i].fading * w);
 			}
 			if (!pow.isNull() && n >= MIN_ESTIMATE_PHOTONS) {
 				float W = CONE_FILTER_NORMALIZATION * M_PI * maxR * maxR;
@@ -399,7 +386,7 @@ bool Ray::end(const Scenerys& scenerys, const Lighting& background, int depth, i
 		paint.reset();
 		return true;
 	}
-	if (!closestScenery(scenerys, _INFINITY)) {
+	if (!closestScenery(scenerys, _INFINITY, FRONT, r ? Metric::SecondaryRays : Metric::PrimaryRays)) {
 		paint = background.light;
 		return true;
 	}
@@ -414,44 +401,58 @@ bool Ray::end(const Scenerys& scenerys, const Lighting& background, int depth, i
 bool Ray::photonEnd(const Scenerys& scenerys, int r) {
 	if ((recursion = r) > MAX_PHOTON_COLLISIONS)
 		return true;
-	if (!closestScenery(scenerys, _INFINITY))
+	if (!closestScenery(scenerys, _INFINITY, FRONT, Metric::PhotonRays))
 		return true;
 	if (scnr->get_isLight())
 		return true;
 	return false;
 }
 
-bool Ray::closestScenery(const Scenerys& scenerys, float maxDistance, Hit target) {
+// 'kind' is the metric the ray is counted in, shadow rays are counted as such whatever it is
+bool Ray::closestScenery(const Scenerys& scenerys, float maxDistance, Hit target, Metric kind) {
 	float		_distance = maxDistance;
 	Hit			_hit = target;
 	A_Scenery*	_closest = NULL;
-	segments.clear_();
-	for (auto scenery = scenerys.begin(), end = scenerys.end(); scenery != end; ++scenery) {
-		if ( (*scenery)->combineType == END ) {
-			if ( (*scenery)->intersection(set_hit(target)) && _distance > dist ) {
-				_closest = *scenery;
-				_distance = dist;
-				_hit = hit;
-				if (target == ALL_SHADOWS) {
-					intersections.activate(*scenery);
-					emplace(intersections, false);
+	auto		_closestIdx = scenerys.end();
+	uint64_t	tests = 0;
+	metric_add(target == ANY_SHADOW || target == ALL_SHADOWS ? Metric::ShadowRays : kind);
+	localSegments().clear_().reserve(SEGMENTS_PER_PRIMITIVE * scenerys.maxChain);
+	auto visit = [&](int first, int last) -> bool {	// on a tie the earlier primitive wins, whatever the visiting order
+		for (auto scenery = scenerys.begin() + first, end = scenerys.begin() + last; scenery != end; ++scenery) {
+			if ( (*scenery)->combineType == END ) {
+				if ( (*scenery)->intersection(set_hit(target)) &&
+					(_distance > dist || (_closest && _distance == dist && scenery < _closestIdx)) ) {
+					_closest = *scenery;
+					_closestIdx = scenery;
+					_distance = dist;
+					_hit = hit;
+					if (target == ALL_SHADOWS) {
+						intersections.activate(*scenery);
+						emplace(intersections, false);
+					}
+				}
+			} else {
+				combine(scenery, end, _distance, target);
+				if (scnr) {
+					_closest = scnr;
+					_distance = dist;
+					_hit = hit;
 				}
 			}
-		} else {
-			combine(scenery, end, _distance, target);
-			if (scnr) {
-				_closest = scnr;
-				_distance = dist;
-				_hit = hit;
+			if (target == ANY_SHADOW && _closest) {
+				tests += scenery - scenerys.begin() + 1 - first;
+				return true;
 			}
 		}
-		if (target == ANY_SHADOW && _closest) {
-			dist = _distance;
-			hit = _hit;
-			scnr = _closest;
-			return true;
-		}
+		tests += last - first;
+		return false;
+	};
+	if (target == ALL_SHADOWS || !scenerys.bvh.isBuiltFor(scenerys)) {
+		visit(0, (int)scenerys.size());
+	} else {
+		scenerys.bvh.traverse(pov, dir, _distance, visit);
 	}
+	metric_add(Metric::IntersectionTests, tests);
 	if (_closest) {
 		dist = _distance;
 		hit = _hit;
@@ -553,15 +554,15 @@ Rays::Rays(void) : std::vector<Ray>() {}
 
 Rays::~Rays(void) {}
 
-Rays& Rays::createPhotons(int amt, const Rgb& pow, const Vec3f& pov, const Vec3f& normal, Distribution distr) {
+Rays& Rays::createPhotons(int amt, const Rgb& pow, const Vec3f& pov, const Vec3f& normal, Distribution distr, Random& random) {
 	LookatAux aux(normal);
 	for (int i = 0; i < amt; i++) {
 		emplace_back(pow, pov);
 		switch (distr) {
 			case DIRECT:			back().dir = normal; break;
-			case SPHERE:			back().dir.randomInUnitSphere(); break;
-			case HEMISPHERE:		back().dir.randomInUnitHemisphere(normal); break;
-			case HEMISPHERE_COSINE:	back().dir.randomInUnitHemisphereCosineDistribution(aux); break;
+			case SPHERE:			back().dir.randomInUnitSphere(random); break;
+			case HEMISPHERE:		back().dir.randomInUnitHemisphere(normal, random); break;
+			case HEMISPHERE_COSINE:	back().dir.randomInUnitHemisphereCosineDistribution(aux, random); break;
 			default: break;
 		}
 	}
@@ -1,15 +1,20 @@
 #ifndef RAY_HPP
 #define RAY_HPP
 
-# include <forward_list>
+# include <vector>
+# include <algorithm>
+# include <type_traits>
 # include "geometry.hpp"
 # include "ARGBColor.hpp"
 # include "Rgb.hpp"
 # include "PhotonMap.hpp"
+# include "Metrics.hpp"
 
 
 class	A_Scenery;
+class	Light;
 struct	Scenerys;
+struct	LightPicker;
 class	PhotonMap;
 
 struct HitRecord;
@@ -18,7 +23,7 @@ struct Traces;
 struct Ray;
 struct Rays;
 
-typedef std::forward_list<PhotonTrace*> phTraces_t;
+typedef std::vector<PhotonTrace> phBuffer_t;
 
 enum Choice {
 	ABSORPTION,
@@ -42,10 +47,10 @@ struct HitRecord {
 	A_Scenery*	scnr;	// pointer to scenery
 	HitRecord(void);
 	HitRecord(const Rgb& _pow, const Vec3f& _pov);
-	~HitRecord(void);
-	HitRecord(const HitRecord& other);
+	~HitRecord(void) = default;
+	HitRecord(const HitRecord& other) = default;
 	HitRecord(Ray& ray, bool photon = false);
-	HitRecord& operator=(const HitRecord& other);
+	HitRecord& operator=(const HitRecord& other) = default;
 };
 
 
@@ -63,6 +68,9 @@ struct PhotonTrace {
 };
 
 
+// A ray is also its shading record: the intersection routines write the CSG
+// interval (intersections, combineType) and the path into it. There is no
+// separate compact ray and no split of the two is planned.
 struct Ray : public HitRecord {
 	struct	Point;
 	struct	Segment;
@@ -76,16 +84,9 @@ struct Ray : public HitRecord {
 		A_Scenery*	s;
 		Point(void) : d(0), inside(false), s(NULL) {}
 		Point(float d, bool inside, A_Scenery* s) : d(d), inside(inside), s(s) {}
-		~Point(void) {}
-		Point(const Point& other) : d(other.d), inside(other.inside), s(other.s) {}
-		Point& operator=(const Point& other) {
-			if (this != &other) {
-				d = other.d;
-				inside = other.inside;
-				s = other.s;
-			}
-			return *this;
-		}
+		~Point(void) = default;
+		Point(const Point& other) = default;
+		Point& operator=(const Point& other) = default;
 		Point& set(float _d, bool _inside, A_Scenery* _s) {
 			d = _d;
 			inside = _inside;
@@ -108,17 +109,9 @@ struct Ray : public HitRecord {
 		Segment(const Point& a, const Point& b) : a(a), b(b), removed(false), combine(false) {}
 		Segment(float ad, bool ai, A_Scenery* as, float bd, bool bi, A_Scenery* bs, bool r, bool c) :
 		a(ad,ai,as), b(bd,bi,bs), removed(r), combine(c) {}
-		Segment(const Segment& other) : a(other.a), b(other.b), removed(other.removed), combine(other.combine) {}
-		~Segment(void) {}
-		Segment& operator=(const Segment& other) {
-			if (this != &other) {
-				a = other.a;
-				b = other.b;
-				removed = other.removed;
-				combine = other.combine;
-			}
-			return *this;
-		}
+		Segment(const Segment& other) = default;
+		~Segment(void) = default;
+		Segment& operator=(const Segment& other) = default;
 		inline void activate(A_Scenery* scenery) {
 			if (scenery) {
 				a.inside = false;
@@ -139,14 +132,20 @@ struct Ray : public HitRecord {
 	};
 
 	struct TraceAround {
-		float fading;
-		PhotonTrace* trace;
-		TraceAround(float i, PhotonTrace* t) : fading(i), trace(t) {}
+		float	distance;
+		float	fading;
+		int		trace;	// index in the photon map
+		TraceAround(float d, float i, int t) : distance(d), fading(i), trace(t) {}
 		TraceAround(void) {}
+		inline bool operator<(const TraceAround& other) const {
+			return distance < other.distance || (distance == other.distance && trace < other.trace);
+		}
 	};
 	
-	struct Segments : public std::forward_list<Segment> {
-		Segments(void) : std::forward_list<Segment>() {}
+	// Scratch list of the CSG segments of one closestScenery call, newest at the back.
+	// One per thread: it keeps its capacity, so a ray in steady state never allocates.
+	struct Segments : public std::vector<Segment> {
+		Segments(void) : std::vector<Segment>() {}
 		~Segments(void) {}
 		Segments& clear_(void) {
 			if (!empty())
@@ -154,22 +153,20 @@ struct Ray : public HitRecord {
 			return *this;
 		}
 	};
+	static inline Segments& localSegments(void) {
+		static thread_local Segments segments;
+		return segments;
+	}
 	
 	class Path {
 		bool _r, _d, _v;
 	public:
 		Path(void) : _r(false), _d(false), _v(false) {}
-		~Path(void) {}
-		Path(const Path& other) : _r(other._r), _d(other._d), _v(other._d) {}
-		Path& operator=(const Path& other) {
-			if (this != &other) {
-				_r = other._r;
-				_d = other._d;
-				_v = other._v;
-			}
-			return *this;
-		}
+		~Path(void) = default;
+		Path(const Path& other) = default;
+		Path& operator=(const Path& other) = default;
 		inline void clear(void) { _r = false; _d = false; _v = false; }
+		inline void merge(const Path& other) { _r |= other._r; _d |= other._d; _v |= other._v; }
 		inline void mark(Choice choice) {
 			switch (choice) {
 				case ABSORPTION:			_d = true;	return;
@@ -192,16 +189,14 @@ struct Ray : public HitRecord {
 	Path		path;			// ray path		| photon path
 	Segment		intersections;	// segment on ray - scenery entry and exit points
 	CombineType	combineType;	// type of object combination
-	Segments	segments;		// container for segments handling
-	phTraces_t	traces;			//				| photon traces
 	
 	Ray(void);
 	Ray(const Rgb& pow, const Vec3f& pov, int r = 1);
 	Ray(const Position pos, const Rgb& _pow);
 	Ray(const Position pos, const Rgb& _pow, const LookatAux& aux);
-	~Ray(void);
-	Ray(const Ray& other);
-	Ray& operator=(const Ray& other);
+	~Ray(void) = default;
+	Ray(const Ray& other) = default;
+	Ray& operator=(const Ray& other) = default;
 	Ray& operator=(const HitRecord& other);
 	Ray& reset(HitRecord& rec);
 	Ray& restore(const HitRecord& rec, bool part = false);
@@ -213,28 +208,30 @@ struct Ray : public HitRecord {
 	Ray& intersection(Segment& segment1, Segment& segment2);
 	Ray& combine(auto& scenery, auto& end, float distance, Hit target);
 	Ray& fakeAmbientLighting(HitRecord& rec, const Rgb& ambient);
-	Ray& directLightings(HitRecord& rec, const Scenerys& scenerys, const Scenerys& lightsIdx);
-	Ray& phMapLightings(HitRecord& rec, const PhotonMap& phMap, MapType type);
+	Ray& directLightings(HitRecord& rec, const Scenerys& scenerys, const LightPicker& lights, int shadowRays);
+	Ray& directLighting(HitRecord& rec, const Scenerys& scenerys, const Light& light, float weight);
+	Ray& phMapLightings(HitRecord& rec, const PhotonMap& phMap, MapType type, PhotonSearch search);
+	bool gridTraces(HitRecord& rec, const PhotonMap& phMap, MapType type, TraceAround* nearest, int& n);
+	bool kdTreeTraces(HitRecord& rec, const PhotonMap& phMap, MapType type, TraceAround* nearest, int& n);
 	bool end(const Scenerys& scenerys, const Lighting& background, int depth, int r);
 	bool photonEnd(const Scenerys& scenerys, int r);
-	bool closestScenery(const Scenerys& scenerys, float maxDistance, Hit target = FRONT);
+	bool closestScenery(const Scenerys& scenerys, float maxDistance, Hit target = FRONT, Metric kind = Metric::PrimaryRays);
 	Choice chooseDirection(const HitRecord& rec, const Probability& p);
 	int getAttenuation(HitRecord& rec, Choice choice, float& fading, float& shining);
 	inline A_Scenery* getCombine(Point& nearest) {
-		auto segment = segments.before_begin(), segmentNext = segments.begin();
-		for (; segment != segments.end(); ++segment) {
-			segmentNext = segment; segmentNext++;
-			while (segmentNext != segments.end() && segmentNext->removed) {
-				segmentNext = segments.erase_after(segment);
-			}
-			if (segmentNext != segments.end() && segmentNext->combine) {
-				if (nearest.d > segmentNext->a.d && segmentNext->a.d >= 0) {
-					nearest = segmentNext->a;
+		Segments& segments = localSegments();
+		segments.erase(std::remove_if(segments.begin(), segments.end(), [](const Segment& segment){
+			return segment.removed;
+		}), segments.end());
+		for (auto segment = segments.rbegin(), end = segments.rend(); segment != end; ++segment) {
+			if (segment->combine) {
+				if (nearest.d > segment->a.d && segment->a.d >= 0) {
+					nearest = segment->a;
 				}
-				if (nearest.d > segmentNext->b.d && segmentNext->b.d >= 0) {
-					nearest = segmentNext->b;
+				if (nearest.d > segment->b.d && segment->b.d >= 0) {
+					nearest = segment->b;
 				}
-				segmentNext->combine = false;
+				segment->combine = false;
 			}
 		}
 		if (nearest.s) {
@@ -258,7 +255,7 @@ struct Ray : public HitRecord {
 		emplace(segment.a, segment.b, _combine);
 	}
 	inline void emplace(const Point& a, const Point& b, bool _combine) {
-		segments.emplace_front(a.d, a.inside, a.s, b.d, b.inside, b.s, false, _combine);
+		localSegments().emplace_back(a.d, a.inside, a.s, b.d, b.inside, b.s, false, _combine);
 	}
 	inline void movePovByDirToDist(void) {
 		pov.addition(pov, dir * dist);
@@ -294,27 +291,27 @@ struct Ray : public HitRecord {
 		if (mattness)
 			dir.addition(dir, Vec3f().randomInSphere(mattness)).normalize();
 	}
-	inline void newPhotonTrace(MapType type, const HitRecord& rec) {
+	inline void newPhotonTrace(MapType type, const HitRecord& rec, phBuffer_t& buffer) {
 		switch (type) {
 			case CAUSTIC: {
 				if (path.isCaustic())
-					traces.push_front(new PhotonTrace(CAUSTIC, rec));
+					buffer.emplace_back(CAUSTIC, rec);
 				break;
 			}
 			case GLOBAL: {
 				if (path.isCaustic())
-					traces.push_front(new PhotonTrace(CAUSTIC, rec));
+					buffer.emplace_back(CAUSTIC, rec);
 				if (path.isGlobal())
-					traces.push_front(new PhotonTrace(GLOBAL, rec));
+					buffer.emplace_back(GLOBAL, rec);
 				break;
 			}
 			case VOLUME: {
 				if (path.isCaustic())
-					traces.push_front(new PhotonTrace(CAUSTIC, rec));
+					buffer.emplace_back(CAUSTIC, rec);
 				if (path.isGlobal())
-					traces.push_front(new PhotonTrace(GLOBAL, rec));
+					buffer.emplace_back(GLOBAL, rec);
 				if (path.isVolume())
-					traces.push_front(new PhotonTrace(VOLUME, rec));
+					buffer.emplace_back(VOLUME, rec);
 				break;
 			}
 			default: break;
@@ -322,6 +319,7 @@ struct Ray : public HitRecord {
 	}
 
 };
+static_assert(std::is_trivially_copyable<Ray>::value, "rays are copied by value in the tracing loops");
 
 bool operator<(const Ray::Segment& left, const Ray::Segment& right);
 
@@ -330,7 +328,7 @@ struct Rays : public std::vector<Ray> {
 	enum Distribution { DIRECT, SPHERE, HEMISPHERE, HEMISPHERE_COSINE };
 	Rays(void);
 	~Rays(void);
-	Rays& createPhotons(int amt, const Rgb& pow, const Vec3f& pov, const Vec3f& normal, Distribution distr);
+	Rays& createPhotons(int amt, const Rgb& pow, const Vec3f& pov, const Vec3f& normal, Distribution distr, Random& random = localRandom());
 	Rays& clear_(int n = 0);
 };
 
@@ -5,22 +5,10 @@
 
 Rgb::Rgb(void) : b(0), g(0), r(0) {}
 
-Rgb::Rgb(const Rgb& other) : b(0), g(0), r(0) { *this = other; }
-
 Rgb::Rgb(int rgba) : b(0), g(0), r(0) { *this = rgba; }
 
 Rgb::Rgb(double _r, double _g, double _b) : b(_b), g(_g), r(_r) {}
 
-Rgb::~Rgb(void) {}
-
-Rgb& Rgb::operator=(const Rgb& other) {
-	if (this != &other) {
-		for (int i = 0; i < 3; i++)
-			raw[i] = other.get_band(i);
-	}
-	return *this;
-}
-
 Rgb& Rgb::operator=(int rgba) {
 	for (int i = 0; i < 3; i++)
 		raw[i] = float(_1_255 * _getСhar(rgba, i));
@@ -83,40 +71,38 @@ std::ostream& operator<<(std::ostream& o, const Rgb& p) {
 
 // class MeanRgb
 
-MeanRgb::MeanRgb(void) : Rgb(), _n(0) {}
+MeanRgb::MeanRgb(void) : _sum(), _n(0) {}
 
-MeanRgb::MeanRgb(const Rgb& other) : Rgb(), _n(0) { *this = other; }
+MeanRgb::MeanRgb(const Rgb& other) : _sum(other), _n(1) {}
 
-MeanRgb::MeanRgb(double _r, double _g, double _b) : Rgb(_r, _g, _b), _n(1) {}
+MeanRgb::MeanRgb(double _r, double _g, double _b) : _sum(_r, _g, _b), _n(1) {}
 
 MeanRgb::~MeanRgb(void) {}
 
+MeanRgb::MeanRgb(const MeanRgb& other) : _sum(other._sum), _n(other._n) {}
+
 MeanRgb& MeanRgb::operator=(const MeanRgb& other) {
 	if (this != &other) {
-		for (int i = 0; i < 3; i++)
-			raw[i] = other.get_band(i);
+		_sum = other._sum;
 		_n = other._n;
 	}
 	return *this;
 }
 
 MeanRgb& MeanRgb::operator=(int rgba) {
-	for (int i = 0; i < 3; i++)
-		raw[i] = _1_255 * _getСhar(rgba, i);
+	_sum = rgba;
 	_n = 1;
 	return *this;
 }
 
 MeanRgb& MeanRgb::operator+=(const Rgb& rgb) {
-	for (int i = 0; i < 3; i++)
-		raw[i] += rgb.get_band(i);
+	_sum += rgb;
 	_n++;
 	return *this;
 }
 
 MeanRgb& MeanRgb::operator+=(int rgba) {
-	for (int i = 0; i < 3; i++)
-		raw[i] += float(_1_255 * _getСhar(rgba, i));
+	_sum += rgba;
 	_n++;
 	return *this;
 }
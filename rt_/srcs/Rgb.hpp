@@ -8,11 +8,12 @@ const float _1_255(1. / 255);
 
 
 // class Rgb
+// Plain float triple, trivially copyable: it is a member of every ray.
 class Rgb {
 protected:
 	union {
-		struct { double b, g, r; };
-		double raw[3];
+		struct { float b, g, r; };
+		float raw[3];
 	};
 	inline int _setСhar(unsigned char c, int i) const {
 		return int(c) << (8 * i);
@@ -22,16 +23,16 @@ protected:
 	}
 public:
 	Rgb(void);
-	Rgb(const Rgb& other);
+	Rgb(const Rgb& other) = default;
 	Rgb(int rgba);
 	Rgb(double _r, double _g, double _b);
-	~Rgb(void);
-	virtual Rgb& operator=(const Rgb& other);
-	virtual Rgb& operator=(int rgba);
-	virtual Rgb& operator+=(const Rgb& other);
-	virtual Rgb& operator+=(int rgba);
-	virtual inline void  reset() { raw[0] = 0; raw[1] = 0; raw[2] = 0; }
-	virtual inline float get_band(int i) const { return deNaN(raw[i]); }
+	~Rgb(void) = default;
+	Rgb& operator=(const Rgb& other) = default;
+	Rgb& operator=(int rgba);
+	Rgb& operator+=(const Rgb& other);
+	Rgb& operator+=(int rgba);
+	inline void  reset() { raw[0] = 0; raw[1] = 0; raw[2] = 0; }
+	inline float get_band(int i) const { return deNaN(raw[i]); }
 	Rgb& operator*=(const Rgb& other);
 	Rgb& operator*=(int rgba);
 	Rgb& operator*=(float f);
@@ -59,19 +60,25 @@ public:
 
 
 // class MeanRgb
-class MeanRgb : public Rgb {
+// Running mean of colours: get_mean() and get_rgba() return the average of the added ones.
+class MeanRgb {
+	Rgb	_sum;
 	int	_n;
 public:
 	MeanRgb(void);
 	MeanRgb(const Rgb& other);
 	MeanRgb(double _r, double _g, double _b);
 	~MeanRgb(void);
+	MeanRgb(const MeanRgb& other);
 	MeanRgb& operator=(const MeanRgb& other);
 	MeanRgb& operator=(int rgba);
 	MeanRgb& operator+=(const Rgb& rgb);
 	MeanRgb& operator+=(int rgba);
-	inline void  reset() { _n = 0; raw[0] = 0; raw[1] = 0; raw[2] = 0; }
-	inline float get_band(int i) const { return _n > 0 ? deNaN(raw[i] * float(1. / _n)) : 0; }
+	inline void  reset() { _n = 0; _sum.reset(); }
+	inline float get_band(int i) const { return _n > 0 ? deNaN(_sum.get_band(i) * float(1. / _n)) : 0; }
+	inline Rgb   get_mean(void) const { return Rgb(get_band(2), get_band(1), get_band(0)); }
+	inline int   get_rgba(float gamma = 1) const { return get_mean().get_rgba(gamma); }
+	inline bool  isNull(void) const { return get_mean().isNull(); }
 };
 
 
@@ -12,13 +12,10 @@ Cameras::~Cameras(void) {}
 
 Scene::Scene(MlxImage& img) :
 img(img),
-scenerys(),
-objsIdx(),
-lightsIdx(),
+snapshot(std::make_shared<SceneSnapshot>()),
 cameras(),
-phMap(),
-textures2(),
 _resolution(DEFAULT_RESOLUTION),
+_fixedResolution(),
 _header(),
 _ambient(1),
 _background(1),
@@ -27,32 +24,14 @@ _currentCamera(0) {
 	_background.set_ratio(_ambient.get_ratio() * BACKGRND_VISIBILITY_FACTOR);
 }
 
-Scene::~Scene(void) {
-	for (auto scenery = scenerys.begin(), end = scenerys.end(); scenery != end; ++scenery) {
-		delete *scenery;
-		*scenery = NULL;
-	}
-	for (auto cam = cameras.begin(), End = cameras.end(); cam != End; ++cam) {
-		for (auto scenery = cam->scenerys.begin(), end = cam->scenerys.end(); scenery != end; ++scenery) {
-			delete *scenery;
-			*scenery = NULL;
-		}
-	}
-	for (auto txtr = textures2.begin(), ENd = textures2.end(); txtr != ENd; ++txtr) {
-		delete txtr->second;
-		txtr->second = NULL;
-	}
-}
+Scene::~Scene(void) {}
 
 Scene::Scene(const Scene& other) :
 img(other.img),
-scenerys(other.scenerys),
-objsIdx(other.objsIdx),
-lightsIdx(other.lightsIdx),
+snapshot(other.snapshot),
 cameras(other.cameras),
-phMap(other.phMap),
-textures2(other.textures2),
 _resolution(other._resolution),
+_fixedResolution(other._fixedResolution),
 _header(other._header),
 _ambient(other._ambient),
 _background(other._background),
@@ -61,13 +40,10 @@ _currentCamera(other._currentCamera)
 
 Scene& Scene::operator=(const Scene& other) {
 	if (this != &other) {
-		scenerys = other.scenerys;
-		objsIdx = other.objsIdx;
-		lightsIdx = other.lightsIdx;
+		snapshot = other.snapshot;
 		cameras = other.cameras;
-		phMap = other.phMap;
-		textures2 = other.textures2;
 		_resolution = other._resolution;
+		_fixedResolution = other._fixedResolution;
 		_header = other._header;
 		_ambient = other._ambient;
 		_background = other._background;
@@ -85,8 +61,8 @@ Texture2* Scene::findTexture(std::string str) {
 	size_t pos = str.find(key) + key.size();
 	if (pos < str.size()) {
 		std::istringstream(str.erase(0, pos)) >> key;
-		auto it = textures2.find(key);
-		if (it != textures2.end())
+		auto it = snapshot->textures2.find(key);
+		if (it != snapshot->textures2.end())
 			return it->second;
 	}
 	return NULL;
@@ -101,7 +77,7 @@ void Scene::systemTexture(void) {
 	txtr1->emplace_back(0x000000);
 	txtr1->set_id(id);
 	txtr1->set_width(2);
-	textures2.try_emplace(id, txtr1);
+	snapshot->textures2.try_emplace(id, txtr1);
 	
 	id = "system2";
 	Texture2* txtr2 = new Texture2();
@@ -111,7 +87,7 @@ void Scene::systemTexture(void) {
 	txtr2->emplace_back(0xFFFFFF);
 	txtr2->set_id(id);
 	txtr2->set_width(2);
-	textures2.try_emplace(id, txtr2);
+	snapshot->textures2.try_emplace(id, txtr2);
 	
 	id = "system3";
 	Texture2* txtr3 = new Texture2();
@@ -126,11 +102,13 @@ void Scene::systemTexture(void) {
 	txtr3->emplace_back(0x444444);
 	txtr3->set_id(id);
 	txtr3->set_width(3);
-	textures2.try_emplace(id, txtr3);
+	snapshot->textures2.try_emplace(id, txtr3);
 }
 
 void Scene::systemDemo(void) {
 	set_any("R	800 800  CornellBox CAUSTIC  500000  60  0.1");
+	if (_fixedResolution.x > 0)
+		_resolution = _fixedResolution;
 	img.init(header(), _resolution);
 	cameras.push_back(Camera(img));
 	set_any("A				0.2 0xFFFFFF");
@@ -169,8 +147,8 @@ void Scene::systemDemo(void) {
 	if (cameras.size() > 1)
 		_currentCamera = 1;
 	saveParsingLog(PARSING_LOGFILE);
-	phMap.make(objsIdx, lightsIdx);
-	makeLookatsForCameras();
+	snapshot->phMap.make(snapshot->objsIdx.update(), snapshot->lightsIdx);
+	initCameras();
 //	cameras[_currentCamera].calculateFlybyRadius();
 //	img.flyby = COUNTER_CLOCKWISE;
 }
@@ -183,7 +161,7 @@ void Scene::mesage(MsgType type, int line, const std::string& hint, int error) {
 		case WRNG_FILE_MISSING:
 			std::cerr << "\nWarning: Missing *.rt file. System demo will be used." <<std::endl;
 			std::cerr << "How to create an *.rt file see default.rt." <<std::endl;
-			std::cerr << "Usage:\n\t\t./rt <filename.rt>" <<std::endl;
+			std::cerr << "Usage:\n\t\t./rt [--headless] [--output=<picture>] [--samples=<n>] [--tile=<pixels>]\n\t\t     [--smoothing=<1..4>] [--shadow-rays=<n>] [--heatmap=<picture>]\n\t\t     [--metrics-dump] [--metrics-file=<file.json|file.csv>] [--profile=<trace.json>] <filename.rt>" <<std::endl;
 			break;
 		case ERR_OPEN_FILE:
 			std::cerr << "\nError: Can't open file: '";
@@ -241,6 +219,7 @@ int Scene::saveParsingLog(const char* filename) {
 }
 
 int  Scene::parsing(int ac, char** av) {
+	profile_scope("scene parsing");
 	systemTexture();
 	if (ac != 2) {
 		mesage(WRNG_FILE_MISSING);
@@ -264,6 +243,8 @@ int  Scene::parsing(int ac, char** av) {
 		_resolution.set_xy(DEFAULT_RESOLUTION);
 		_header = "Default";
 	}
+	if (_fixedResolution.x > 0)
+		_resolution = _fixedResolution;
 	img.init(header(), _resolution);
 	cameras.push_back(Camera(img));	// default camera '0'
 	for (int ln = 2; !in.eof(); ln++) {
@@ -280,18 +261,23 @@ int  Scene::parsing(int ac, char** av) {
 	} else {
 		mesage(WRNG_PARSING_ERROR1, 0, av[1]);
 	}
-	if (lightsIdx.empty()) {
+	if (snapshot->lightsIdx.empty()) {
 		mesage(WRNG_PARSING_ERROR2, 0, av[1]);
 	}
-	if (objsIdx.empty()) {
+	if (snapshot->objsIdx.empty()) {
 		mesage(WRNG_PARSING_ERROR3, 0, av[1]);
 	}
 	saveParsingLog(PARSING_LOGFILE);
-	phMap.make(objsIdx, lightsIdx);
-	makeLookatsForCameras();
+	snapshot->phMap.make(snapshot->objsIdx.update(), snapshot->lightsIdx);
+	initCameras();
 	return SUCCESS;
 }
 
+void Scene::set_fixedResolution(const Vec2i& resolution) {
+	_fixedResolution.x = i2limits(resolution.x, RESOLUTION_MIN, RESOLUTION_MAX);
+	_fixedResolution.y = i2limits(resolution.y, RESOLUTION_MIN, RESOLUTION_MAX);
+}
+
 int  Scene::get_currentCamera(void) { return _currentCamera;}
 
 bool Scene::set_currentCamera(int idx) {
@@ -305,6 +291,15 @@ bool Scene::set_currentCamera(int idx) {
 	return false;
 }
 
+void Scene::set_options(const Options& options) {
+	for (auto cam = cameras.begin(), end = cameras.end(); cam != end; ++cam) {
+		cam->resetTileSize(options.tileSize);
+		cam->shadowRays = options.shadowRays;
+		if (options.smoothing)
+			cam->resetSmoothingFactor(options.smoothing);
+	}
+}
+
 int Scene::set_any(std::string string) {
 	return set_any(std::istringstream(string));
 }
@@ -321,6 +316,7 @@ int Scene::set_any(std::istringstream is) {
 	}
 	switch (id) {
 		case 0: {// R Resolution
+			PhotonMap& phMap = snapshot->phMap;
 			is >> _resolution.x >> _resolution.y >> _header >> phMapType >> phMap.totalPhotons >> phMap.estimate >> phMap.gridStep ;
 			_resolution.x = i2limits(_resolution.x, RESOLUTION_MIN, RESOLUTION_MAX);
 			_resolution.y = i2limits(_resolution.y, RESOLUTION_MIN, RESOLUTION_MAX);
@@ -459,15 +455,15 @@ int Scene::set_any(std::istringstream is) {
 			break;
 		}
 		default: {//
-			if (scenerys.size() > 0) {
+			if (snapshot->scenerys.size() > 0) {
 				if (iD == "UNION") {
-					scenerys.back()->combineType = UNION;
+					snapshot->scenerys.back()->combineType = UNION;
 				} else if (iD == "SUBTRACTION") {
-					scenerys.back()->combineType = SUBTRACTION;
+					snapshot->scenerys.back()->combineType = SUBTRACTION;
 				} else if (iD == "INTERSECTION") {
-					scenerys.back()->combineType = INTERSECTION;
+					snapshot->scenerys.back()->combineType = INTERSECTION;
 				} else if (iD == "END") {
-					scenerys.back()->combineType = END;
+					snapshot->scenerys.back()->combineType = END;
 				} else {
 					return ERROR;
 				}
@@ -478,25 +474,21 @@ int Scene::set_any(std::istringstream is) {
 }
 
 void Scene::set_scenery(A_Scenery* scenery) {
-	scenerys.push_back(scenery);
+	snapshot->scenerys.push_back(scenery);
 //	scenerys.back()->set_id((int)scenerys.size());
-	if ( scenerys.back()->get_isLight() ) {
-		lightsIdx.push_back(scenery);
+	if ( snapshot->scenerys.back()->get_isLight() ) {
+		snapshot->lightsIdx.push_back(scenery);
 	} else {
-		objsIdx.push_back(scenery);
+		snapshot->objsIdx.push_back(scenery);
 	}
 }
 
-void Scene::makeLookatsForCameras(void) {
-	for (auto cam = cameras.begin(), End = cameras.end(); cam != End; ++cam) {
-		for (auto sc = scenerys.begin(), end = scenerys.end(); sc != end; ++sc) {
-			A_Scenery* clone = (*sc)->clone();
-			cam->set_scenery(clone);
-		}
-		if (phMap.type != NO)
-			cam->phMap = phMap;
-	}
+// The snapshot is complete here: from now on it is read only and shared by all cameras.
+void Scene::initCameras(void) {
+	snapshot->scenerys.update();
+	snapshot->updateLights();
 	for (auto cam = cameras.begin(), End = cameras.end(); cam != End; ++cam) {
+		cam->set_scene(snapshot);
 		cam->initMatrix();
 		cam->lookatCamera(cam->get_pos());
 		cam->ambient = _ambient;
@@ -512,8 +504,52 @@ void Scene::rt(bool timerOn) {
 	cCam->runThreadRoutine(RAYS_TRACING);
 	displayTimeMs(elapsedTimeMs(start, cond_path), "Path tarcing time");
 	displayTimeMs(elapsedTimeMs(start, cond_ray),  "Ray  tarcing time");
+	start = std::chrono::high_resolution_clock::now();
 	cCam->runThreadRoutine(TAKE_PICTURE, &this->img);
-	mlx_put_image_to_window(img.get_mlx(), img.get_win(), img.get_image(), 0, 0);
+	displayTimeMs(elapsedTimeMs(start, cond_path || cond_ray), "Take picture time");
+	if (cond_path || cond_ray)
+		outputTracingStats(*cCam);
+# ifndef RT_HEADLESS
+	if (!img.get_headless())
+		mlx_put_image_to_window(img.get_mlx(), img.get_win(), img.get_image(), 0, 0);
+# endif
+}
+
+// One more pass of progressive path tracing, while the current camera has not converged.
+bool Scene::refine(void) {
+	Camera&	cam(cameras[_currentCamera]);
+	if (cam.tracingType != PATH || cam.isConverged())
+		return false;
+	rt();
+	if (cam.isConverged() && TIMER_MODE)
+		std::cout << "Path tracing: " << cam.get_passes() << " samples per pixel" << std::endl;
+	return true;
+}
+
+// Traces 'samples' passes of path tracing, or one pass of ray tracing if 0, with the current camera.
+Camera& Scene::render(int samples) {
+	Camera*	cCam = &cameras[_currentCamera];
+	if (snapshot->phMap.type != NO)
+		cCam->photonMap = snapshot->phMap.type;
+	if (samples > 0)
+		cCam->changeOther(PATHTRACING);
+	for (int i = 0; i < std::max(samples, 1); i++)
+		cCam->runThreadRoutine(RAYS_TRACING);
+	return *cCam;
+}
+
+int Scene::renderPicture(const std::string& filename, int samples, const std::string& heatmap) {
+	auto start = std::chrono::high_resolution_clock::now();
+	Camera*	cCam = &render(samples);
+	displayTimeMs(elapsedTimeMs(start, TIMER_MODE), samples > 0 ? "Path tarcing time" : "Ray  tarcing time");
+	if (TIMER_MODE)
+		outputTracingStats(*cCam);
+	int res = cCam->savePicture(filename);
+	if (res == SUCCESS)
+		std::cout << "Picture saved: '" << filename << "'" << std::endl;
+	if (res == SUCCESS && !heatmap.empty() && (res = cCam->saveHeatmap(heatmap)) == SUCCESS)
+		std::cout << "Heatmap saved: '" << heatmap << "'" << std::endl;
+	return res;
 }
 
 void Scene::selectCamera(int ctrl) {
@@ -588,7 +624,7 @@ void Scene::flybyCamera(void) {
 		cameras[_currentCamera].photonMap == NO) {
 		Camera&		cam(cameras[_currentCamera]);
 		Position	pos(cam.get_pos());
-		float angle = degree2radian(FLYBY_STEP / 10.), radius = cam.get_flybyRadius();
+		float angle = degree2radian(float(FLYBY_STEP) / 10.), radius = cam.get_flybyRadius();
 		if (img.flyby == CLOCKWISE) {
 			angle = -angle;
 		}
@@ -621,7 +657,7 @@ void Scene::changeCamerasOptions(int key, int option) {
 			break;
 		}
 		case PHOTON_MAP: {
-			if (cameras[0].phMap.type == NO) return;
+			if (snapshot->phMap.type == NO) return;
 //			if (cameras[0].tracingType == PATH) return;
 			if (cameras[0].photonMap == NO && (MapType)key == NO) return;
 			img.flyby = OFF;
@@ -643,6 +679,10 @@ void Scene::changeCamerasOptions(int key, int option) {
 				case BACKGROUND_LIGHT: { if (cameras[0].ambient.get_ratio() == 0) return;
 					break;
 				}
+				case PHOTON_SEARCH: { if (snapshot->phMap.type == NO) return;
+					std::cout << "Photon search......." << (cameras[0].photonSearch == GRID_SEARCH ? "kd-tree" : "grid") << std::endl;
+					break;
+				}
 				default:
 					break;
 			}
@@ -669,23 +709,23 @@ void Scene::changeCamerasOptions(int key, int option) {
 std::ostream& operator<<(std::ostream& o, const Scene& sc) {
 	std::ostringstream os;
 	o	<< "R " << std::setw(5) << sc._resolution.x << " " << sc._resolution.y << " " << sc._header;
-	if (sc.phMap.type != NO) {
-		o	<< " " << mapType(sc.phMap.type) << " " << sc.phMap.totalPhotons << " "
-			<< sc.phMap.estimate << " " << sc.phMap.gridStep;
+	if (sc.snapshot->phMap.type != NO) {
+		o	<< " " << mapType(sc.snapshot->phMap.type) << " " << sc.snapshot->phMap.totalPhotons << " "
+			<< sc.snapshot->phMap.estimate << " " << sc.snapshot->phMap.gridStep;
 	}
 	o	<< std::endl;
 	os	<< "A ";
 	o	<< std::setw(53) << std::left << os.str();
 	o	<< sc._ambient;
 	o	<< "  #ambient liting" << std::endl;
-	for (auto light = sc.lightsIdx.begin(); light != sc.lightsIdx.end(); ++light) {
+	for (auto light = sc.snapshot->lightsIdx.begin(); light != sc.snapshot->lightsIdx.end(); ++light) {
 		o << *(*light) << std::endl;
 	}
 	int i = 0;
 	for (auto camera = ++sc.cameras.begin(); camera != sc.cameras.end(); ++camera, ++i) {
 		o << *camera << " " << i << std::endl;
 	}
-	for (auto obj = sc.objsIdx.begin(); obj != sc.objsIdx.end(); ++obj) {
+	for (auto obj = sc.snapshot->objsIdx.begin(); obj != sc.snapshot->objsIdx.end(); ++obj) {
 		o << *(*obj) << std::endl;
 		if ((*obj)->combineType) {
 			o << combineType((*obj)->combineType) << std::endl;
@@ -714,3 +754,79 @@ int outputFile(const char* filename) {
 	in.close();
 	return SUCCESS;
 }
+
+// Takes the options out of 'av' and leaves the program name and the *.rt file.
+int parseOptions(int& ac, char** av, Options& options) {
+	int n = 1;
+	for (int i = 1; i < ac; i++) {
+		std::string arg(av[i]);
+		if (arg == "--headless") {
+			options.headless = true;
+		} else if (arg.compare(0, 9, "--output=") == 0) {
+			options.output = arg.substr(9);
+			options.headless = true;
+		} else if (arg.compare(0, 10, "--samples=") == 0) {
+			std::istringstream is(arg.substr(10));
+			if (!(is >> options.samples) || options.samples < 0) {
+				std::cerr << "\nError: Invalid option: '" << arg << "'. Samples should be a non-negative integer." << std::endl;
+				return ERROR;
+			}
+		} else if (arg.compare(0, 10, "--heatmap=") == 0) {
+			options.heatmap = arg.substr(10);
+			options.headless = true;
+		} else if (arg.compare(0, 12, "--smoothing=") == 0) {
+			std::istringstream is(arg.substr(12));
+			if (!(is >> options.smoothing) || options.smoothing < 1 || options.smoothing > 4) {
+				std::cerr << "\nError: Invalid option: '" << arg << "'. Smoothing factor should be in the range [1,4]." << std::endl;
+				return ERROR;
+			}
+		} else if (arg.compare(0, 7, "--tile=") == 0) {
+			std::istringstream is(arg.substr(7));
+			if (!(is >> options.tileSize) || options.tileSize < TILE_SIZE_MIN || options.tileSize > TILE_SIZE_MAX) {
+				std::cerr	<< "\nError: Invalid option: '" << arg << "'. Tile size should be in the range ["
+							<< TILE_SIZE_MIN << "," << TILE_SIZE_MAX << "]." << std::endl;
+				return ERROR;
+			}
+		} else if (arg.compare(0, 14, "--shadow-rays=") == 0) {
+			std::istringstream is(arg.substr(14));
+			if (!(is >> options.shadowRays) || options.shadowRays < 1 || options.shadowRays > SHADOW_RAYS_MAX) {
+				std::cerr	<< "\nError: Invalid option: '" << arg << "'. Shadow rays should be in the range [1,"
+							<< SHADOW_RAYS_MAX << "]." << std::endl;
+				return ERROR;
+			}
+		} else if (arg == "--metrics-dump") {
+			options.metricsDump = true;
+		} else if (arg.compare(0, 15, "--metrics-file=") == 0) {
+			options.metricsFile = arg.substr(15);
+		} else if (arg.compare(0, 10, "--profile=") == 0) {
+# ifndef RT_PROFILE
+			std::cerr << "\nError: Invalid option: '" << arg << "'. Profiling needs a build with -DRT_PROFILE." << std::endl;
+			return ERROR;
+# endif
+			options.profileFile = arg.substr(10);
+		} else if (arg.compare(0, 2, "--") == 0) {
+			std::cerr << "\nError: Unknown option: '" << arg << "'." << std::endl;
+			return ERROR;
+		} else {
+			av[n++] = av[i];
+		}
+	}
+	ac = n;
+	if (options.headless && options.output.empty())
+		options.output = DEFAULT_PICTURE;
+	for (auto& picture : {options.output, options.heatmap}) {
+		if (!picture.empty() && pictureFormat(picture) == UNKNOWN_FORMAT) {
+			std::cerr << "\nError: Unknown picture format: '" << picture << "'. Use *.ppm, *.png, *.pfm or *.exr" << std::endl;
+			return ERROR;
+		}
+	}
+	return SUCCESS;
+}
+
+void outputTracingStats(Camera& camera) {
+	size_t samples = camera.countSamples(), pixels = camera.matrix.size();
+	std::cout	<< "  tiles.............." << camera.get_numTiles() << " of " << camera.get_tileSize()
+				<< "x" << camera.get_tileSize() << " px in Morton order" << std::endl;
+	std::cout	<< "  samples............" << samples << ", " << roundedString(float(samples) / pixels, 2)
+				<< " per pixel of " << camera.get_sm() * camera.get_sm() << (camera.isAdaptiveAA() ? " (adaptive)" : "") << std::endl;
+}
@@ -2,20 +2,21 @@
 # define SCENE_HPP
 
 # include <fstream>
+# include <map>
 # include <random>
 # include "MlxImage.hpp"
 # include "camera.hpp"
-# include "PhotonMap.hpp"
+# include "SceneSnapshot.hpp"
 # include "Sphere.hpp"
 # include "Light.hpp"
 # include "Planar.hpp"
 # include "Sp2.hpp"
+# include "Picture.hpp"
 
 class	MlxImage;
 class	Camera;
 
 typedef std::vector<std::string>				stringSet_t;
-typedef std::map<std::string, Texture2*>		textures2_t;
 
 enum MsgType {
 	WELLCOM_MSG,
@@ -29,6 +30,22 @@ enum MsgType {
 };
 
 
+// Command line options, see parseOptions()
+struct Options {
+	bool		headless;	// render one picture to 'output' without a window
+	std::string	output;
+	int			samples;	// path tracing passes per pixel, 0: one ray tracing pass
+	int			tileSize;
+	std::string	heatmap;	// picture of the samples per pixel, next to 'output'
+	int			smoothing;	// 0: the cameras' own smoothing factor
+	int			shadowRays;
+	bool		metricsDump;	// print the render metrics on exit
+	std::string	metricsFile;	// save them on exit, *.json or CSV
+	std::string	profileFile;	// Chrome trace of the profile scopes, RT_PROFILE builds
+	Options(void) : headless(false), output(), samples(0), tileSize(DEFAULT_TILE_SIZE), heatmap(), smoothing(0), shadowRays(DEFAULT_SHADOW_RAYS), metricsDump(false), metricsFile(), profileFile() {}
+};
+
+
 struct Cameras : public std::vector<Camera> {
 	Cameras(void);
 	~Cameras(void);
@@ -41,14 +58,11 @@ struct Scene {
 //		 0   1   2   3   4    5    6     7     8     9     10   11   12    13    14    15	16
 	};
 	MlxImage&	img;
-	Scenerys	scenerys;
-	Scenerys	objsIdx;
-	Scenerys	lightsIdx;
+	std::shared_ptr<SceneSnapshot>	snapshot;
 	Cameras		cameras;
-	PhotonMap	phMap;
-	textures2_t	textures2;
 private:
 	Vec2i		_resolution;
+	Vec2i		_fixedResolution;	// if not zero, replaces the resolution of the *.rt file
 	std::string	_header;
 	Lighting	_ambient;
 	Lighting	_background;
@@ -65,13 +79,18 @@ public:
 	void mesage(MsgType type, int line = 0, const std::string& hint = "", int error = 0);
 	int  saveParsingLog(const char* filename);
 	int	 parsing(int ac, char** av);
+	void set_fixedResolution(const Vec2i& resolution);
 	int  get_currentCamera(void);
 	bool set_currentCamera(int idx);
+	void set_options(const Options& options);
 	int  set_any(std::string string);
 	int  set_any(std::istringstream is);
 	void set_scenery(A_Scenery* scenery);
-	void makeLookatsForCameras(void);
+	void initCameras(void);
 	void rt(bool timerOn = false);
+	bool refine(void);
+	Camera& render(int samples);
+	int  renderPicture(const std::string& filename, int samples, const std::string& heatmap = "");
 	void selectCamera(int ctrl);
 	void changeCameraFOV(int ctrl);
 	void moveCamera(int ctrl);
@@ -81,5 +100,7 @@ public:
 	friend std::ostream& operator<<(std::ostream& o, const Scene& sc);
 };
 	int  outputFile(const char* filename);
+	int  parseOptions(int& ac, char** av, Options& options);
+	void outputTracingStats(Camera& camera);
 
 #endif /* SCENE_HPP */
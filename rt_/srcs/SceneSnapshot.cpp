@@ -0,0 +1,38 @@
+#include "SceneSnapshot.hpp"
+
+
+// struct SceneSnapshot
+
+SceneSnapshot::SceneSnapshot(void) :
+scenerys(),
+objsIdx(),
+lightsIdx(),
+directLights(),
+pointLights(),
+areaLights(),
+phMap(),
+textures2()
+{}
+
+SceneSnapshot::~SceneSnapshot(void) {
+	for (auto scenery = scenerys.begin(), end = scenerys.end(); scenery != end; ++scenery) {
+		delete *scenery;
+		*scenery = NULL;
+	}
+	for (auto txtr = textures2.begin(), end = textures2.end(); txtr != end; ++txtr) {
+		delete txtr->second;
+		txtr->second = NULL;
+	}
+}
+
+void SceneSnapshot::updateLights(void) {
+	std::vector<Light*> lights, points;
+	for (auto light = lightsIdx.begin(), end = lightsIdx.end(); light != end; ++light) {
+		lights.push_back(static_cast<Light*>(*light));
+		if (!lights.back()->isPlanar())
+			points.push_back(lights.back());
+	}
+	directLights.update(lights, false);
+	pointLights.update(points, false);
+	areaLights.update(lights, true);
+}
@@ -0,0 +1,32 @@
+#ifndef SCENESNAPSHOT_HPP
+# define SCENESNAPSHOT_HPP
+
+# include <map>
+# include <memory>
+# include "PhotonMap.hpp"
+# include "Light.hpp"
+
+typedef std::map<std::string, Texture2*>		textures2_t;
+
+
+// The world-space scene: scenery with its BVH, textures and photon map. The Scene
+// fills it while parsing; after that it is read only and shared by all cameras,
+// and freed with the last of them.
+struct SceneSnapshot {
+	Scenerys	scenerys;
+	Scenerys	objsIdx;
+	Scenerys	lightsIdx;
+	LightPicker	directLights;	// all lights, RAY mode
+	LightPicker	pointLights;	// lights without a surface, PATH mode
+	LightPicker	areaLights;		// planar lights by their glowing surface, PATH mode
+	PhotonMap	phMap;
+	textures2_t	textures2;
+	SceneSnapshot(void);
+	~SceneSnapshot(void);
+	SceneSnapshot(const SceneSnapshot& other) = delete;
+	SceneSnapshot& operator=(const SceneSnapshot& other) = delete;
+	void updateLights(void);
+};
+
+
+#endif /* SCENESNAPSHOT_HPP */
@@ -30,17 +30,13 @@ public:
 			ray.norm.product(-1);
 		}
 	}
-	inline void	lookat(const Position& eye, const LookatAux& aux, const Vec3f& pos, float roll) {
-		(void)pos;
-		_sphere->lookat(eye, aux, roll);
-	}
-	inline void	roll(const Vec3f& pos, float roll) {
-		(void)pos;
-		_sphere->roll(roll);
-	}
 	inline bool  intersection(Ray& ray) {
 		return _sphere->intersection(ray.pov, ray.dir, ray.dist, ray.intersections.a.d, ray.intersections.b.d, ray.hit);
 	}
+	inline bool  getBounds(Aabb& box) const {
+		box.expand(_sphere->pos.p, Vec3f(_sphere->r, _sphere->r, _sphere->r));
+		return true;
+	}
 	inline float lighting(Ray& ray) const {
 		(void)ray;
 		return 0;
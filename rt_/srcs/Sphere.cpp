@@ -1,16 +1,14 @@
 #include "Sphere.hpp"
 
 
-Sphere::Sphere(void) : A_Scenery("sphere", "sp", false), _radius(0), _sqrRadius(0), _k(), _c(0) {}
+Sphere::Sphere(void) : A_Scenery("sphere", "sp", false), _radius(0), _sqrRadius(0) {}
 
 Sphere::~Sphere(void) {}
 
 Sphere::Sphere(const Sphere& other) :
 A_Scenery(other),
 _radius(other._radius),
-_sqrRadius(_radius * _radius),
-_k(other._k),
-_c(other._c)
+_sqrRadius(_radius * _radius)
 {}
 
 Sphere* Sphere::clone(void) const {
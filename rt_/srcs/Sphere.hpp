@@ -8,8 +8,6 @@ class Sphere : public A_Scenery {
 protected:
 	float 	_radius;
 	float 	_sqrRadius;
-	Vec3f	_k;
-	float	_c;
 public:
 	Sphere(void);
 	~Sphere(void);
@@ -30,35 +28,16 @@ public:
 			normalToRaySphereIntersect(ray.pov, _pos.p, ray.norm);
 		}
 	}
-	inline void	 lookat(const Position& eye, const LookatAux& aux, const Vec3f& pos, float roll) {
-		_pos.lookat(eye, aux, roll);
-		_k.substract(pos,_pos.p);
-		_c = _k * _k - _sqrRadius;
-	}
-	inline void	 roll(const Vec3f& pos, float shiftRoll) {
-		if (shiftRoll != 0) {
-			_pos.roll(shiftRoll);
-			_k.substract(pos,_pos.p);
-			_c = _k * _k - _sqrRadius;
-		}
-	}
 	inline bool	 intersection(Ray& ray) {
-		bool result = false;
-		if (ray.hit == ANY_SHADOW || ray.hit == ALL_SHADOWS) {
+		if (ray.hit == ANY_SHADOW || ray.hit == ALL_SHADOWS)
 			ray.hit = FRONT;
-			result = raySphereIntersection(ray.dir, ray.pov, _pos.p, _sqrRadius,
-										   ray.dist, ray.intersections.a.d, ray.intersections.b.d,
-										   ray.hit);
-		} else if (!ray.recursion) {
-			result = raySphereIntersection(ray.dir, _k, _c, ray.dist,
-										   ray.intersections.a.d, ray.intersections.b.d,
-										   ray.hit);
-		} else {
-			result = raySphereIntersection(ray.dir, ray.pov, _pos.p, _sqrRadius,
-										   ray.dist, ray.intersections.a.d, ray.intersections.b.d,
-										   ray.hit);
-		}
-		return result;
+		return raySphereIntersection(ray.dir, ray.pov, _pos.p, _sqrRadius,
+									 ray.dist, ray.intersections.a.d, ray.intersections.b.d,
+									 ray.hit);
+	}
+	inline bool  getBounds(Aabb& box) const {
+		box.expand(_pos.p, Vec3f(_radius, _radius, _radius));
+		return true;
 	}
 	inline void  photonEmissions(int num, phRays_t& rays) const {
 		(void)num; (void)rays;
@@ -0,0 +1,113 @@
+#include "ThreadPool.hpp"
+
+
+static thread_local bool insidePool = false;
+
+ThreadPool::ThreadPool(size_t numThreads) :
+_workers(),
+_queues(numThreads),
+_mtx(),
+_submit(),
+_wake(),
+_done(),
+_pending(0),
+_generation(0),
+_stop(false)
+{
+	for (size_t id = 0; id < numThreads - 1; id++)
+		_workers.emplace_back([this, id](){ workerRoutine(id); });
+}
+
+ThreadPool::~ThreadPool(void) {
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_stop = true;
+	}
+	_wake.notify_all();
+	for (auto worker = _workers.begin(), end = _workers.end(); worker != end; ++worker)
+		worker->join();
+}
+
+ThreadPool& ThreadPool::get(void) {
+	static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+	return pool;
+}
+
+bool ThreadPool::pop(size_t id, Tile& tile) {
+	Queue& queue = _queues[id];
+	std::lock_guard<std::mutex> lock(queue.mtx);
+	if (queue.tiles.empty())
+		return false;
+	tile = queue.tiles.front();
+	queue.tiles.pop_front();
+	return true;
+}
+
+bool ThreadPool::steal(size_t id, Tile& tile) {
+	for (size_t i = 1, size = _queues.size(); i < size; i++) {
+		Queue& queue = _queues[(id + i) % size];
+		std::lock_guard<std::mutex> lock(queue.mtx);
+		if (!queue.tiles.empty()) {
+			tile = queue.tiles.back();
+			queue.tiles.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::drain(size_t id) {
+	Tile tile;
+	while (pop(id, tile) || steal(id, tile)) {
+		(*tile.task)(tile.begin, tile.end);
+		if (--_pending == 0) {
+			std::lock_guard<std::mutex> lock(_mtx);
+			_done.notify_all();
+		}
+	}
+}
+
+void ThreadPool::workerRoutine(size_t id) {
+	size_t generation = 0;
+	insidePool = true;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_mtx);
+			_wake.wait(lock, [this, generation](){ return _stop || _generation != generation; });
+			if (_stop)
+				return;
+			generation = _generation;
+		}
+		drain(id);
+	}
+}
+
+void ThreadPool::run(size_t size, size_t grain, const task_t& task) {
+	if (!size)
+		return;
+	if (!grain)
+		grain = 1;
+	if (insidePool || _queues.size() == 1) {
+		task(0, size);
+		return;
+	}
+	std::lock_guard<std::mutex> submit(_submit);
+	size_t numTiles = (size + grain - 1) / grain;
+	size_t numQueues = _queues.size();
+	_pending = numTiles;
+	for (size_t q = 0; q < numQueues; q++) {
+		std::lock_guard<std::mutex> lock(_queues[q].mtx);
+		for (size_t t = q * numTiles / numQueues, end = (q + 1) * numTiles / numQueues; t < end; t++)
+			_queues[q].tiles.push_back({&task, t * grain, std::min(size, (t + 1) * grain)});
+	}
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_generation++;
+	}
+	_wake.notify_all();
+	insidePool = true;
+	drain(numQueues - 1);
+	insidePool = false;
+	std::unique_lock<std::mutex> lock(_mtx);
+	_done.wait(lock, [this](){ return _pending == 0; });
+}
@@ -0,0 +1,82 @@
+#ifndef THREADPOOL_HPP
+# define THREADPOOL_HPP
+
+# include <algorithm>
+# include <thread>
+# include <mutex>
+# include <condition_variable>
+# include <atomic>
+# include <deque>
+# include <vector>
+# include <functional>
+# include "Header.h"
+
+
+// Long-lived pool of render threads shared by all cameras and the photon map.
+// A job [0, size) is cut into tiles of 'grain' elements, the tiles are dealt out
+// in contiguous blocks to per-worker queues, and a worker whose queue runs dry
+// steals from the far end of its neighbours' queues.
+class ThreadPool {
+public:
+	typedef std::function<void(size_t begin, size_t end)> task_t;
+private:
+	struct Tile {
+		const task_t*	task;
+		size_t			begin;
+		size_t			end;
+	};
+	struct Queue {
+		std::mutex			mtx;
+		std::deque<Tile>	tiles;
+	};
+	std::vector<std::thread>	_workers;
+	std::vector<Queue>			_queues;	// one per worker plus one for the submitting thread
+	std::mutex					_mtx;
+	std::mutex					_submit;
+	std::condition_variable		_wake;
+	std::condition_variable		_done;
+	std::atomic<size_t>			_pending;
+	size_t						_generation;
+	bool						_stop;
+	ThreadPool(size_t numThreads);
+	ThreadPool(const ThreadPool& other);
+	ThreadPool& operator=(const ThreadPool& other);
+	bool pop(size_t id, Tile& tile);
+	bool steal(size_t id, Tile& tile);
+	void drain(size_t id);
+	void workerRoutine(size_t id);
+public:
+	~ThreadPool(void);
+	static ThreadPool& get(void);
+	inline size_t get_size(void) const { return _queues.size(); }
+	void run(size_t size, size_t grain, const task_t& task);
+
+	// Stable parallel sort: one block per thread is sorted, then blocks are merged pairwise.
+	template <class It, class Compare>
+	void sort(It first, It last, Compare comp) {
+		size_t size = last - first, parts = get_size();
+		if (parts == 1 || size < parts * PARALLEL_SORT_MIN) {
+			std::stable_sort(first, last, comp);
+			return;
+		}
+		std::vector<size_t> bounds(parts + 1);
+		for (size_t p = 0; p <= parts; p++)
+			bounds[p] = p * size / parts;
+		run(parts, 1, [&](size_t begin, size_t end){
+			for (size_t p = begin; p < end; p++)
+				std::stable_sort(first + bounds[p], first + bounds[p + 1], comp);
+		});
+		for (size_t width = 1; width < parts; width *= 2) {
+			run((parts + 2 * width - 1) / (2 * width), 1, [&](size_t begin, size_t end){
+				for (size_t q = begin; q < end; q++) {
+					size_t lo = q * 2 * width, mid = std::min(lo + width, parts), hi = std::min(lo + 2 * width, parts);
+					if (mid < hi)
+						std::inplace_merge(first + bounds[lo], first + bounds[mid], first + bounds[hi], comp);
+				}
+			});
+		}
+	}
+};
+
+
+#endif /* THREADPOOL_HPP */
@@ -17,12 +17,12 @@ public:
 	inline void off(void) { _on = false; }
 	inline void start(void) {
 		if (_on)
-			_start = std::chrono::high_resolution_clock::now();
+			_start = std::chrono::steady_clock::now();
 	}
 	inline void read(void) {
 		if (_on)
 			_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-					std::chrono::high_resolution_clock::now() - _start).count();
+					std::chrono::steady_clock::now() - _start).count();
 	}
 	inline void output(std::string hint = "") {
 		if (!_on)
@@ -0,0 +1,317 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "MlxImage.hpp"
+#include "Metrics.hpp"
+
+// Rendering benchmark of the bundled scenes: 'make bench', then from the project root
+//	./rt_bench [--samples=<n>] [--tile=<pixels>] [--resolution=<w>x<h>] [--runs=<n>]
+//	           [--output=<file.json>] [--compare=<baseline.json>] [--threshold=<percent>] [<filename.rt> ...]
+// Every run of a scene is a child process of its own, so the peak resident set size
+// is the scene's and nothing is shared between scenes. Rays are seeded by pixel,
+// sample and frame, so the same options trace the same rays on every run.
+// With several runs, the times of the fastest run are kept.
+// --compare reads a previous output and exits with an error if a scene got slower
+// than the threshold allows.
+
+# define BENCH_SAMPLES		4		// path tracing passes, 0: one ray tracing pass
+# define BENCH_THRESHOLD	10		// percent of slowdown tolerated by --compare
+# define BENCH_MIN_MS		20		// shorter times are too noisy to compare
+
+Var	var;
+
+static const stringSet_t benchScenes {
+	"scenes/CornellBox.rt", "scenes/SystemDemo.rt", "scenes/arches.rt",
+	"scenes/balls.rt", "scenes/sp2.rt", "scenes/default.rt"
+};
+
+struct BenchOptions {
+	Options		render;
+	Vec2i		resolution;	// 0x0: the scenes' own
+	int			runs;
+	int			threshold;
+	std::string	output;
+	std::string	compare;
+	stringSet_t	scenes;
+	BenchOptions(void) : render(), resolution(), runs(1), threshold(BENCH_THRESHOLD), output(), compare(), scenes() {
+		render.headless = true;
+		render.samples = BENCH_SAMPLES;
+	}
+};
+
+struct BenchResult {
+	std::string	scene;
+	Vec2i		resolution;
+	int			threads;
+	double		parseMs;
+	double		photonMapMs;
+	double		renderMs;
+	uint64_t	rays;			// shadow rays included
+	uint64_t	shadowRays;
+	long		peakRssKb;
+	BenchResult(void) : scene(), resolution(), threads(0), parseMs(0), photonMapMs(0), renderMs(0), rays(0), shadowRays(0), peakRssKb(0) {}
+	double mraysPerSecond(void) const { return renderMs > 0 ? rays / (renderMs * 1000.) : 0; }
+};
+
+static double msSince(const std::chrono::steady_clock::time_point& start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string sceneName(const std::string& filename) {
+	size_t begin = filename.find_last_of('/');
+	begin = begin == std::string::npos ? 0 : begin + 1;
+	size_t end = filename.rfind(".rt");
+	return filename.substr(begin, end == std::string::npos || end < begin ? std::string::npos : end - begin);
+}
+
+// Runs in the child process: parses and renders the scene, writes the measures to 'fd'.
+static int benchScene(const std::string& filename, const BenchOptions& options, int fd) {
+	int devNull = open("/dev/null", O_WRONLY);
+	if (devNull >= 0) {	// the parsing and photon map reports, './rt_headless <filename.rt>' shows them
+		dup2(devNull, STDOUT_FILENO);
+		dup2(devNull, STDERR_FILENO);
+	}
+	MlxImage	img;
+	Scene		scene(img);
+	var.img		= &img;
+	var.scene	= &scene;
+	img.set_headless(true);
+	if (options.resolution.x > 0)
+		scene.set_fixedResolution(options.resolution);
+	std::string	path(filename);
+	char*		av[] = { (char*)"rt_bench", &path[0], NULL };
+	auto start = std::chrono::steady_clock::now();
+	if (scene.parsing(2, av))
+		return ERROR;
+	double parseMs = msSince(start);
+	double photonMapMs = scene.snapshot->phMap.type != NO ? scene.snapshot->phMap.get_time() * 1000. : 0;
+	scene.set_options(options.render);
+	common::MetricValues before = common::MetricsRegistry::snapshot();
+	start = std::chrono::steady_clock::now();
+	scene.render(options.render.samples);
+	double renderMs = msSince(start);
+	common::MetricValues after = common::MetricsRegistry::snapshot();
+	uint64_t shadowRays = after[size_t(Metric::ShadowRays)] - before[size_t(Metric::ShadowRays)];
+	uint64_t rays = common::rays_total(after) - common::rays_total(before) - shadowRays;
+	std::ostringstream os;
+	os	<< std::setprecision(12) << parseMs - photonMapMs << " " << photonMapMs << " " << renderMs << " "
+		<< rays << " " << shadowRays << " " << img.get_width() << " " << img.get_height() << " "
+		<< ThreadPool::get().get_size() << std::endl;
+	std::string out(os.str());
+	return write(fd, out.data(), out.size()) == (ssize_t)out.size() ? SUCCESS : ERROR;
+}
+
+static int runScene(const std::string& filename, const BenchOptions& options, BenchResult& result) {
+	int fds[2];
+	if (pipe(fds) != 0) {
+		std::cerr << "\nError: pipe: " << strerror(errno) << std::endl;
+		return ERROR;
+	}
+	std::cout << std::flush;
+	pid_t pid = fork();
+	if (pid < 0) {
+		std::cerr << "\nError: fork: " << strerror(errno) << std::endl;
+		return ERROR;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		int res = benchScene(filename, options, fds[1]);
+		::_exit(res == SUCCESS ? 0 : 1);	// skips the destructors of the scene and the thread pool
+	}
+	close(fds[1]);
+	std::string	out;
+	char		buf[256];
+	for (ssize_t n; (n = read(fds[0], buf, sizeof(buf))) != 0; ) {
+		if (n > 0)
+			out.append(buf, n);
+		else if (errno != EINTR)
+			break;
+	}
+	close(fds[0]);
+	int				status = 0;
+	struct rusage	usage;
+	if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return ERROR;
+	std::istringstream is(out);
+	BenchResult run;
+	run.scene = sceneName(filename);
+	if (!(is >> run.parseMs >> run.photonMapMs >> run.renderMs >> run.rays >> run.shadowRays >> run.resolution.x >> run.resolution.y >> run.threads))
+		return ERROR;
+	run.rays += run.shadowRays;
+	run.peakRssKb = usage.ru_maxrss;
+# ifdef __APPLE__
+	run.peakRssKb /= 1024;	// bytes on macOS
+# endif
+	if (result.scene.empty() || run.renderMs < result.renderMs) {
+		run.peakRssKb = std::max(run.peakRssKb, result.peakRssKb);
+		result = run;
+	} else {
+		result.peakRssKb = std::max(result.peakRssKb, run.peakRssKb);
+	}
+	return SUCCESS;
+}
+
+static std::ostream& writeJson(std::ostream& o, const BenchOptions& options, const std::vector<BenchResult>& results) {
+	o	<< std::fixed << std::setprecision(3)
+		<< "{\n  \"samples\": " << options.render.samples
+		<< ",\n  \"tile\": " << options.render.tileSize
+		<< ",\n  \"runs\": " << options.runs
+		<< ",\n  \"scenes\": [\n";
+	for (auto r = results.begin(), end = results.end(); r != end; ++r) {
+		o	<< "    {\"scene\": \"" << r->scene << "\", \"resolution\": \"" << r->resolution.x << "x" << r->resolution.y
+			<< "\", \"threads\": " << r->threads
+			<< ", \"parse_ms\": " << r->parseMs
+			<< ", \"photon_map_ms\": " << r->photonMapMs
+			<< ", \"render_ms\": " << r->renderMs
+			<< ", \"rays\": " << r->rays
+			<< ", \"shadow_rays\": " << r->shadowRays
+			<< ", \"mrays_per_s\": " << r->mraysPerSecond()
+			<< ", \"peak_rss_kb\": " << r->peakRssKb << "}" << (r + 1 != end ? "," : "") << "\n";
+	}
+	return o << "  ]\n}" << std::endl;
+}
+
+// Reads the value of "key" in 'line', a line of writeJson()
+static bool jsonField(const std::string& line, const std::string& key, std::string& value) {
+	size_t pos = line.find("\"" + key + "\": ");
+	if (pos == std::string::npos)
+		return false;
+	pos += key.size() + 4;
+	size_t end = line[pos] == '"' ? line.find('"', ++pos) : line.find_first_of(",}", pos);
+	value = line.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+	return true;
+}
+
+static double jsonNumber(const std::string& line, const std::string& key) {
+	std::string value;
+	return jsonField(line, key, value) ? std::atof(value.c_str()) : 0;
+}
+
+// Returns the number of slowdowns beyond the threshold, or ERROR
+static int compare(const BenchOptions& options, const std::vector<BenchResult>& results) {
+	std::ifstream	in(options.compare);
+	std::string		line, value;
+	std::map<std::string, std::string> baseline;
+	if (in.fail()) {
+		std::cerr << "\nError: Can't open file: '" << options.compare << "'. " << strerror(errno) << std::endl;
+		return ERROR;
+	}
+	int samples = -1;
+	while (std::getline(in, line)) {
+		if (jsonField(line, "scene", value))
+			baseline[value] = line;
+		else if (jsonField(line, "samples", value))
+			samples = std::atoi(value.c_str());
+	}
+	if (samples != options.render.samples)
+		std::cerr << "Warning: the baseline was rendered with " << samples << " samples." << std::endl;
+	float limit = 1 + options.threshold / 100.f;
+	int slowdowns = 0;
+	std::cerr << "\nCompared to '" << options.compare << "', threshold " << options.threshold << "%:" << std::endl;
+	for (auto r = results.begin(), end = results.end(); r != end; ++r) {
+		auto base = baseline.find(r->scene);
+		std::string resolution = std::to_string(r->resolution.x) + "x" + std::to_string(r->resolution.y);
+		if (base == baseline.end() || !jsonField(base->second, "resolution", value) || value != resolution) {
+			std::cerr << "  " << std::left << std::setw(12) << r->scene << " not in the baseline at " << resolution << std::endl;
+			continue;
+		}
+		const std::pair<const char*, double> times[] = {
+			{ "parse_ms", r->parseMs }, { "photon_map_ms", r->photonMapMs }, { "render_ms", r->renderMs }
+		};
+		for (auto& time : times) {
+			double was = jsonNumber(base->second, time.first);
+			if (was < BENCH_MIN_MS && time.second < BENCH_MIN_MS)
+				continue;
+			bool slower = time.second > std::max(was, double(BENCH_MIN_MS)) * limit;
+			slowdowns += slower;
+			std::cerr	<< "  " << std::left << std::setw(12) << r->scene << std::setw(14) << time.first << std::right
+						<< std::fixed << std::setprecision(1) << std::setw(10) << was << " -> " << std::setw(10) << time.second
+						<< std::showpos << std::setw(8) << (was > 0 ? (time.second / was - 1) * 100 : 0) << "%" << std::noshowpos
+						<< (slower ? "  SLOWER" : "") << std::endl;
+		}
+	}
+	return slowdowns;
+}
+
+static int parseBenchOptions(int ac, char** av, BenchOptions& options) {
+	int n = 1;
+	for (int i = 1; i < ac; i++) {
+		std::string arg(av[i]);
+		if (arg.compare(0, 13, "--resolution=") == 0) {
+			std::istringstream is(arg.substr(13));
+			char x = 0;
+			if (!(is >> options.resolution.x >> x >> options.resolution.y) || x != 'x' ||
+				options.resolution.x < RESOLUTION_MIN || options.resolution.x > RESOLUTION_MAX ||
+				options.resolution.y < RESOLUTION_MIN || options.resolution.y > RESOLUTION_MAX) {
+				std::cerr	<< "\nError: Invalid option: '" << arg << "'. Resolution should be <width>x<height> in the range ["
+							<< RESOLUTION_MIN << "," << RESOLUTION_MAX << "]." << std::endl;
+				return ERROR;
+			}
+		} else if (arg.compare(0, 7, "--runs=") == 0) {
+			std::istringstream is(arg.substr(7));
+			if (!(is >> options.runs) || options.runs < 1) {
+				std::cerr << "\nError: Invalid option: '" << arg << "'. Runs should be a positive integer." << std::endl;
+				return ERROR;
+			}
+		} else if (arg.compare(0, 12, "--threshold=") == 0) {
+			std::istringstream is(arg.substr(12));
+			if (!(is >> options.threshold) || options.threshold < 0) {
+				std::cerr << "\nError: Invalid option: '" << arg << "'. Threshold should be a non-negative percent." << std::endl;
+				return ERROR;
+			}
+		} else if (arg.compare(0, 9, "--output=") == 0) {
+			options.output = arg.substr(9);
+		} else if (arg.compare(0, 10, "--compare=") == 0) {
+			options.compare = arg.substr(10);
+		} else if (arg == "--headless" || arg.compare(0, 10, "--heatmap=") == 0) {
+			std::cerr << "\nError: Invalid option: '" << arg << "'. The benchmark saves no pictures." << std::endl;
+			return ERROR;
+		} else {
+			av[n++] = av[i];	// --samples, --tile, --smoothing, --shadow-rays and the *.rt files
+		}
+	}
+	if (parseOptions(n, av, options.render))
+		return ERROR;
+	for (int i = 1; i < n; i++)
+		options.scenes.push_back(av[i]);
+	if (options.scenes.empty())
+		options.scenes = benchScenes;
+	return SUCCESS;
+}
+
+int main(int ac, char** av) {
+	BenchOptions options;
+	if (parseBenchOptions(ac, av, options))
+		return ERROR;
+	std::vector<BenchResult> results;
+	for (auto file = options.scenes.begin(), end = options.scenes.end(); file != end; ++file) {
+		BenchResult result;
+		for (int run = 0; run < options.runs; run++) {
+			if (runScene(*file, options, result)) {
+				std::cerr << "\nError: Benchmark of '" << *file << "' failed, see './rt_headless " << *file << "'." << std::endl;
+				return ERROR;
+			}
+		}
+		std::cerr	<< std::left << std::setw(12) << result.scene << std::right << std::fixed << std::setprecision(1)
+					<< " parse " << result.parseMs << "ms, photon map " << result.photonMapMs << "ms, render "
+					<< result.renderMs << "ms, " << std::setprecision(2) << result.mraysPerSecond() << " Mrays/s, peak RSS "
+					<< result.peakRssKb / 1024 << "MB" << std::endl;
+		results.push_back(result);
+	}
+	if (options.output.empty()) {
+		writeJson(std::cout, options, results);
+	} else {
+		std::ofstream out(options.output, std::ios::out | std::ios::trunc);
+		if (out.fail() || !writeJson(out, options, results)) {
+			std::cerr << "\nError: Can't write file: '" << options.output << "'." << std::endl;
+			return ERROR;
+		}
+	}
+	if (options.compare.empty())
+		return SUCCESS;
+	int slowdowns = compare(options, results);
+	if (slowdowns > 0)
+		std::cerr << "\n" << slowdowns << " slowdown" << (slowdowns > 1 ? "s" : "") << " beyond " << options.threshold << "%" << std::endl;
+	return slowdowns ? ERROR : SUCCESS;
+}
@@ -51,53 +51,26 @@ std::istringstream& operator>>(std::istringstream& is, Fov& fov) {
 
 // struct Pixel
 
-Pixel::Pixel(const Vec3f& cPos, int sm, float tan, const Vec3f& pos) :
-rays(), cPos(cPos), paint() {
-	reset(sm, tan, pos);
-}
+Pixel::Pixel(void) : paint(), samples(0) {}
 
 Pixel::~Pixel(void) {}
 
 Pixel::Pixel(const Pixel& other) :
-rays(other.rays),
-cPos(other.cPos),
-paint(other.paint)
+paint(other.paint),
+samples(other.samples)
 {}
 
 Pixel& Pixel::operator=(const Pixel& other) {
 	if (this != &other) {
-		rays = other.rays;
-		cPos = other.cPos;
 		paint = other.paint;
+		samples = other.samples;
 	}
 	return *this;
 }
 
-void Pixel::reset(int sm, float tan, const Vec3f& pos) {
-	int sqrSm = sm * sm;
-	rays.clear_(sqrSm);
-	for (int i = 0; i < sqrSm; i++) {
-		rays.push_back(Ray());
-	}
-	restoreRays(sm, tan, pos);
-}
-
-void Pixel::restoreRays(int sm, float tan, const Vec3f& pov) {
-	auto ray = rays.begin(), end = rays.end();
+void Pixel::reset(void) {
 	paint.reset();
-	for (int j = 0; j < sm; j++) {
-		for (int i = 0; i < sm && ray != end; i++, ++ray) {
-			ray->dir.x = (cPos.x + i * cPos.z) * tan;
-			ray->dir.y = (cPos.y + j * cPos.z) * tan;
-			ray->dir.z = 1;
-			ray->dir.normalize();
-			ray->pov = pov;
-			ray->recursion = 0;
-//			ray->paint.reset();
-			ray->path.clear();
-			ray->scnr = NULL;
-		}
-	}
+	samples = 0;
 }
 
 // class Matirx
@@ -151,16 +124,23 @@ Matrix(),
 _base(BASE),
 _pos(_base),
 _roll(0),
+_eye(_base.p),
+_axes(),
+_view(),
 _flybyRadius(0),
-scenerys(),
-objsIdx(),
-lightsIdx(),
-phMap(),
+_frame(0),
+_passes(0),
+_tileSize(DEFAULT_TILE_SIZE),
+_tiles(),
+_firstRgba(),
+snapshot(),
 ambient(),
 background(),
 depth(DEFAULT_RECURSION_DEPTH),
 paths(DAFAULT_PATHS_PER_RAY),
+shadowRays(DEFAULT_SHADOW_RAYS),
 photonMap(NO),
+photonSearch(KDTREE_SEARCH),
 tracingType(RAY),
 fakeAmbientLightOn(true),
 directLightOn(true)
@@ -172,7 +152,7 @@ directLightOn(true)
 
 Camera::~Camera(void) {}
 
-Camera::Camera(const Camera& other) : phMap(other.phMap) { *this = other; }
+Camera::Camera(const Camera& other) : Matrix(other) { *this = other; }
 
 Camera& Camera::operator=(const Camera& other) {
 	if (this != &other) {
@@ -186,16 +166,23 @@ Camera& Camera::operator=(const Camera& other) {
 		matrix = other.matrix;
 		_pos = other._pos;
 		_roll = other._roll;
+		_eye = other._eye;
+		_axes = other._axes;
+		_view = other._view;
 		_flybyRadius = other._flybyRadius;
-		scenerys = other.scenerys;
-		objsIdx = other.objsIdx;
-		lightsIdx = other.lightsIdx;
-		phMap = other.phMap;
+		_frame = other._frame;
+		_passes = other._passes;
+		_tileSize = other._tileSize;
+		_tiles = other._tiles;
+		_firstRgba = other._firstRgba;
+		snapshot = other.snapshot;
 		ambient = other.ambient;
 		background = other.background;
 		depth = other.depth;
 		paths = other.paths;
+		shadowRays = other.shadowRays;
 		photonMap = other.photonMap;
+		photonSearch = other.photonSearch;
 		tracingType = other.tracingType;
 		fakeAmbientLightOn = other.fakeAmbientLightOn;
 		directLightOn = other.directLightOn;
@@ -209,32 +196,61 @@ float Camera::get_rollDegree(void) const { return radian2degree(_roll); }
 
 float Camera::get_flybyRadius(void) const { return _flybyRadius; }
 
-void Camera::set_scenery(A_Scenery* scenery) {
-	scenerys.push_back(scenery);
-	if ( scenerys.back()->get_isLight() == true ) {
-		lightsIdx.push_back(scenery);
-	} else {
-		objsIdx.push_back(scenery);
-	}
+int Camera::get_passes(void) const { return _passes; }
+
+int Camera::get_tileSize(void) const { return _tileSize; }
+
+size_t Camera::get_numTiles(void) const { return _tiles.size(); }
+
+// Ray tracing is done in one pass, path tracing refines the picture pass after pass up to 'paths'.
+bool Camera::isConverged(void) const {
+	return _passes >= (tracingType == PATH ? paths : 1);
 }
 
+// Ray tracing with smoothing traces one sample per pixel, then the rest of the
+// samples only where the picture has edges. Path tracing noise would refine everything.
+bool Camera::isAdaptiveAA(void) const { return _sm > 1 && tracingType == RAY; }
+
+size_t Camera::countSamples(void) const {
+	size_t samples = 0;
+	for (auto pixel = matrix.begin(), end = matrix.end(); pixel != end; ++pixel)
+		samples += pixel->samples;
+	return samples;
+}
+
+void Camera::set_scene(std::shared_ptr<const SceneSnapshot> snapshot) { this->snapshot = snapshot; }
+
 void Camera::set_posToBase(void) { _pos = _base; }
 
 void Camera::initMatrix(void) {
-	Vec2i	mPos; // pixel xy-coordinate on the monitor (width*height pixels, xy(0,0) in the upper left corner, Y-axis direction down);
-	Vec3f	cPos; // pixel xy-coordinate on the canvas (width=1, xy(0,0) in the center, XY-axes up and right directions)
-	float	sm_mult = 1. / _sm;
-	float	tan = _fov.get_tan();
-	matrix.reserve(_width * _height);
-	for (mPos.y = 0; mPos.y < _height; mPos.y++) {
-		for (mPos.x = 0; mPos.x < _width; mPos.x++) {
-			cPos.x = mPos.x;
-			cPos.y = mPos.y;
-			cPos.z = sm_mult;
-			cPos = cPos.toRt(_width, _height) * _mult;
-			matrix.push_back( Pixel(cPos, _sm, tan, _pos.p) );
+	matrix.assign(_width * _height, Pixel());
+	initTiles();
+}
+
+static uint32_t mortonCode(uint32_t x, uint32_t y) {
+	uint32_t code = 0;
+	for (int bit = 0; bit < 16; bit++)
+		code |= ((x >> bit & 1) << (2 * bit)) | ((y >> bit & 1) << (2 * bit + 1));
+	return code;
+}
+
+void Camera::initTiles(void) {
+	std::vector<std::pair<uint32_t, ImageTile>> tiles;
+	for (int y = 0; y < _height; y += _tileSize) {
+		for (int x = 0; x < _width; x += _tileSize) {
+			ImageTile tile = {x, y, std::min(x + _tileSize, _width), std::min(y + _tileSize, _height)};
+			tiles.push_back({mortonCode(x / _tileSize, y / _tileSize), tile});
 		}
 	}
+	std::sort(tiles.begin(), tiles.end(), [](const auto& l, const auto& r){ return l.first < r.first; });
+	_tiles.clear();
+	for (auto& tile : tiles)
+		_tiles.push_back(tile.second);
+}
+
+void Camera::resetTileSize(int tileSize) {
+	_tileSize = i2limits(tileSize, TILE_SIZE_MIN, TILE_SIZE_MAX);
+	initTiles();
 }
 
 void Camera::restoreRays(Camera* camera, size_t begin, size_t end) {
@@ -246,20 +262,14 @@ void Camera::resetRays(Camera* camera, size_t begin, size_t end) {
 }
 
 void Camera::restoreRays_lll(size_t begin, size_t end) {
-	float tan = _fov.get_tan();
 	for (auto pixel = matrix.begin() + begin, _end = matrix.begin() + end; pixel != _end; ++pixel) {
-		pixel->restoreRays(_sm, tan, _pos.p);
+		pixel->reset();
 	}
 }
 
 void Camera::resetRays_lll(size_t begin, size_t end) {
 	paths = DAFAULT_PATHS_PER_RAY;
-	float sm_mult = (1. / _sm) * _mult;
-	float tan = _fov.get_tan();
-	for (auto pixel = matrix.begin() + begin, _end = matrix.begin() + end; pixel != _end; ++pixel) {
-		pixel->cPos.z = sm_mult;
-		pixel->reset(_sm, tan, _pos.p);
-	}
+	restoreRays_lll(begin, end);
 }
 
 bool Camera::resetFovDegree(float degree) {
@@ -282,7 +292,6 @@ void Camera::resetRecursionDepth(int rd) {
 
 void Camera::resetPathsPerRay(int key) {
 	paths = pprs[key];
-	runThreadRoutine(RESTORE_RAYS);
 }
 
 void Camera::changePhotonMap(MapType type) {
@@ -324,6 +333,10 @@ void Camera::changeOther(Controls key) {
 			tracingType = PATH;
 			break;
 		}
+		case PHOTON_SEARCH: {
+			photonSearch = photonSearch == GRID_SEARCH ? KDTREE_SEARCH : GRID_SEARCH;
+			break;
+		}
 		default:
 			break;
 	}
@@ -340,25 +353,37 @@ void Camera::resetRoll(float roll) {
 	} else {
 		roll = degree2radian(roll);
 	}
-	float shiftRoll = roll - _roll;
 	_roll = roll;
-	for (auto sc = scenerys.begin(), end = scenerys.end(); sc != end; ++sc) {
-		(*sc)->roll(_pos.p, shiftRoll);
-	}
+	updateView();
 	runThreadRoutine(RESTORE_RAYS);
 	if (DEBUG_MODE) { std::cout << "roll: " << radian2degree(_roll) << std::endl; }
 }
 
+// 'pos' is given in the camera's own (unrolled) axes; the scene stays in world space
+// and only the camera's eye and axes move.
 void Camera::lookatCamera(const Position& pos) {
 	LookatAux aux(pos.n);
-	for (auto sc = scenerys.begin(), end = scenerys.end(); sc != end; ++sc) {
-		(*sc)->lookat(pos, aux, _base.p, _roll);
-	}
-	phMap.lookat(pos, aux, _roll);
+	_eye = _eye + toWorld(pos.p - _base.p);
+	aux.right = toWorld(aux.right).normalize();
+	aux.up = toWorld(aux.up).normalize();
+	aux.dir = toWorld(aux.dir).normalize();
+	_axes = aux;
+	updateView();
 	set_posToBase();
 	runThreadRoutine(RESTORE_RAYS);
 }
 
+Vec3f Camera::toWorld(const Vec3f& v) const {
+	return _axes.right * v.x + _axes.up * v.y + _axes.dir * v.z;
+}
+
+void Camera::updateView(void) {
+	Vec3f right(1, 0, 0), up(0, 1, 0);
+	_view.right = toWorld(right.turnAroundZ(-_roll));
+	_view.up = toWorld(up.turnAroundZ(-_roll));
+	_view.dir = _axes.dir;
+}
+
 void Camera::takePicture_lll(MlxImage& img, size_t begin, size_t end) {
 	char* data = img.get_data();
 	if (data) {
@@ -376,11 +401,58 @@ void Camera::takePicture(Camera* camera, MlxImage& img, size_t begin, size_t end
 	camera->takePicture_lll(img, begin, end);
 }
 
+int Camera::savePicture(const std::string& filename) const {
+	std::vector<Rgb> picture(matrix.size());
+	for (size_t i = 0, size = matrix.size(); i < size; i++)
+		picture[i] = matrix[i].paint.get_mean();
+	return ::savePicture(filename, _width, _height, picture);
+}
+
+// Sub-sample 'sample' of an sm * sm grid, row by row, in the pixel 'idx'. The pixel's
+// xy-coordinate on the monitor (xy(0,0) in the upper left corner, Y-axis down) goes
+// to the canvas (width=1, xy(0,0) in the center, XY-axes up and right directions).
+void Camera::primaryRay(size_t idx, int sample, Ray& ray) const {
+	float	sm_mult = 1. / _sm;
+	float	tan = _fov.get_tan();
+	Vec3f	cPos(idx % _width, idx / _width, sm_mult);
+	cPos = cPos.toRt(_width, _height) * _mult;
+	float	x = (cPos.x + (sample % _sm) * cPos.z) * tan;
+	float	y = (cPos.y + (sample / _sm) * cPos.z) * tan;
+	ray.dir = _view.right * x + _view.up * y + _view.dir;
+	ray.dir.normalize();
+	ray.pov = _eye;
+	ray.recursion = 0;
+	ray.path.clear();
+	ray.scnr = NULL;
+}
+
+void Camera::tracePixel(Pixel& pixel, size_t idx, size_t first, size_t last) {
+	Random& random = localRandom();
+	Ray ray;
+	for (size_t sample = first; sample < last; sample++) {
+		primaryRay(idx, sample, ray);
+		random.seed(idx, sample, _frame);
+		tarcing(ray);
+		pixel.paint += ray.paint;
+	}
+	pixel.samples += last - first;
+	metric_add(Metric::Samples, last - first);
+}
+
 void Camera::raysTracing_lll(size_t begin, size_t end) {
-	for (auto pixel = matrix.begin() + begin, End = matrix.begin() + end; pixel != End; ++pixel) {
-		for (auto ray = pixel->rays.begin(), _end = pixel->rays.end(); ray != _end; ++ray) {
-			tarcing(*ray);
-			pixel->paint += ray->paint;
+	bool adaptive = isAdaptiveAA();
+	for (auto tile = _tiles.begin() + begin, tEnd = _tiles.begin() + end; tile != tEnd; ++tile) {
+		for (int y = tile->y0; y < tile->y1; y++) {
+			for (int x = tile->x0; x < tile->x1; x++) {
+				size_t idx = y * _width + x;
+				Pixel& pixel = matrix[idx];
+				if (adaptive) {
+					tracePixel(pixel, idx, 0, 1);
+					_firstRgba[idx] = pixel.paint.get_rgba(GAMMA);
+				} else {
+					tracePixel(pixel, idx, 0, _sm * _sm);
+				}
+			}
 		}
 	}
 }
@@ -389,122 +461,285 @@ void Camera::raysTracing(Camera* camera, size_t begin, size_t end) {
 	camera->raysTracing_lll(begin, end);
 }
 
-void Camera::tarcing(Ray& ray, int r) {
-	if (!ray.end(scenerys, background, depth, r)){
-		HitRecord rec(ray.getNormal());
-		if (tracingType == RAY) {
-			reflections(ray, rec, rec.scnr->reflective, r);
-			refractions(ray, rec, rec.scnr->refractive, r);
-		} else if (tracingType == PATH) {
-			if (ray.path.isDiffusion()) {
-				ambientLightPathsTarcing(ray, rec, r);
-			} else {
-				reflections(ray, rec, rec.scnr->reflective, r);
-				refractions(ray, rec, rec.scnr->refractive, r);
-				if (ray.path.isDiffusion())
-					ambientLightPathsTarcing(ray, rec, r);
+// A pixel is on an edge if one of its 8 neighbours differs by AA_CONTRAST_THRESHOLD in some band.
+bool Camera::isEdge(int x, int y) const {
+	ARGBColor	color(_firstRgba[y * _width + x]), other;
+	const int	dx[] = {-1, 1, 0, 0, -1, 1, -1, 1}, dy[] = {0, 0, -1, 1, -1, -1, 1, 1};
+	for (int i = 0; i < 8; i++) {
+		int nx = x + dx[i], ny = y + dy[i];
+		if (nx < 0 || ny < 0 || nx >= _width || ny >= _height)
+			continue;
+		other.val = _firstRgba[ny * _width + nx];
+		for (int band = 0; band < 3; band++)
+			if (std::abs(color.raw[band] - other.raw[band]) >= AA_CONTRAST_THRESHOLD)
+				return true;
+	}
+	return false;
+}
+
+void Camera::refineTracing_lll(size_t begin, size_t end) {
+	for (auto tile = _tiles.begin() + begin, tEnd = _tiles.begin() + end; tile != tEnd; ++tile) {
+		for (int y = tile->y0; y < tile->y1; y++) {
+			for (int x = tile->x0; x < tile->x1; x++) {
+				size_t idx = y * _width + x;
+				if (isEdge(x, y))
+					tracePixel(matrix[idx], idx, 1, _sm * _sm);
 			}
 		}
-		lightings(ray, rec);
+	}
+}
+
+void Camera::refineTracing(Camera* camera, size_t begin, size_t end) {
+	camera->refineTracing_lll(begin, end);
+}
+
+// Samples per pixel from blue (one) to red (all sm * sm).
+int Camera::saveHeatmap(const std::string& filename) const {
+	// blue at the fewest samples a pixel got, red at the most: path tracing
+	// passes add samples to every pixel, so no fixed count bounds them
+	std::vector<Rgb> picture(matrix.size());
+	int least = matrix.empty() ? 0 : matrix[0].samples, most = least;
+	for (const auto& pixel : matrix) {
+		least = std::min(least, pixel.samples);
+		most = std::max(most, pixel.samples);
+	}
+	float full = std::max(most - least, 1);
+	for (size_t i = 0, size = matrix.size(); i < size; i++) {
+		float t = (matrix[i].samples - least) / full;
+		picture[i] = Rgb(t, 1 - std::abs(2 * t - 1), 1 - t);
+	}
+	return ::savePicture(filename, _width, _height, picture, 1);
+}
+
+void Camera::tarcing(Ray& ray, int r) {
+	if (tracingType == RAY) {
+		traceRay(ray, r);
+	} else if (!ray.end(snapshot->scenerys, background, depth, r)){
+		HitRecord rec(ray.getNormal());
+		if (!ray.path.isDiffusion())
+			traceBranches(ray, rec, r);
+		if (ray.path.isDiffusion())
+			ambientLightPathsTarcing(ray, rec, r);
+		lightings(ray, rec, r);
 		ray.paint = rec.paint;
 	}
 }
 
 void Camera::traceRay(Ray& ray, int r) {
-	if (!ray.end(scenerys, background, depth, r)){
+	if (!ray.end(snapshot->scenerys, background, depth, r)){
 		HitRecord rec(ray.getNormal());
-		reflections(ray, rec, rec.scnr->reflective, r);
-		refractions(ray, rec, rec.scnr->refractive, r);
-		lightings(ray, rec);
+		traceBranches(ray, rec, r);
+		lightings(ray, rec, r);
 		ray.paint = rec.paint;
 	}
 }
 
-void Camera::reflections(Ray& ray, HitRecord& rec, float fading, int r) {
-	if (fading) {
-		ray.reflect();
-		traceRay(ray, ++r);
-		ray.paint.attenuate(rec.scnr->diffusion ? -1 : rec.scnr->getColor(rec), fading);
-		ray.reset(rec);
-	}
+namespace {
+	// A reflected or refracted ray waiting to be traced, with the weight its light gets at the root hit
+	struct Branch {
+		Ray		ray;
+		Rgb		weight;
+		int		r;
+	};
 }
 
-void Camera::refractions(Ray& ray, HitRecord& rec, float fading, int r) {
-	if (fading) {
-		int attenuation = rec.scnr->getColor(rec);
+static void reflectedBranch(std::vector<Branch>& stack, const Ray& ray, const HitRecord& rec, const Rgb& weight, float fading, int r) {
+	stack.push_back({ray, weight, r + 1});
+	stack.back().ray.reflect();
+	stack.back().weight.attenuate(rec.scnr->diffusion ? -1 : rec.scnr->getColor(rec), fading);
+}
+
+// The reflected and refracted rays leaving the hit 'rec'; the Schlick share of a refraction
+// is reflected, all of it on total internal reflection.
+static void pushBranches(std::vector<Branch>& stack, const Ray& ray, const HitRecord& rec, const Rgb& weight, int r) {
+	float reflective = rec.scnr->reflective, refractive = rec.scnr->refractive;
+	if (reflective)
+		reflectedBranch(stack, ray, rec, weight, reflective, r);
+	if (refractive) {
 		float schlick = 0;
-		if (ray.refract((rec.hit == INSIDE ? rec.scnr->matIOR : rec.scnr->matOIR), schlick)) {
-			traceRay(ray, r + 1);
-			ray.paint.attenuate(attenuation, fading - schlick);
-			ray.reset(rec);
+		Branch refracted = {ray, weight, r + 1};
+		if (refracted.ray.refract((rec.hit == INSIDE ? rec.scnr->matIOR : rec.scnr->matOIR), schlick)) {
+			refracted.weight.attenuate(rec.scnr->getColor(rec), refractive - schlick);
+			stack.push_back(refracted);
 			if (schlick > 0)
-				reflections(ray, rec, schlick, r);
+				reflectedBranch(stack, ray, rec, weight, schlick, r);
 		} else {
-			reflections(ray, rec, 1.0, r);
-			if (ray.recursion > depth)
-				ray.paint = background.light;
+			reflectedBranch(stack, ray, rec, weight, 1.0, r);
+		}
+	}
+}
+
+// The ray tracing tree below the hit 'rec' without recursion: branches wait on a small
+// explicit stack and their weighted light goes straight to rec.paint.
+void Camera::traceBranches(Ray& ray, HitRecord& rec, int r) {
+	static thread_local std::vector<Branch> stack;	// keeps its capacity between calls
+	stack.clear();
+	pushBranches(stack, ray, rec, Rgb(1, 1, 1), r);
+	while (!stack.empty()) {
+		Branch branch = stack.back();
+		stack.pop_back();
+		if (!branch.ray.end(snapshot->scenerys, background, depth, branch.r)) {
+			HitRecord hit(branch.ray.getNormal());
+			pushBranches(stack, branch.ray, hit, branch.weight, branch.r);
+			lightings(branch.ray, hit, branch.r);
+			branch.ray.paint = hit.paint;
 		}
+		rec.paint += branch.ray.paint *= branch.weight;
+		ray.path.merge(branch.ray.path);
 	}
 }
 
-void Camera::lightings(Ray& ray, HitRecord& rec) {
+// Factor of the light of a PATH bounce, the ambient light ratio when the fake ambient light is on
+float Camera::pathFading(void) const {
+	float fading = fakeAmbientLightOn ? ambient.get_ratio() : 1;
+	return fading == 0 ? 1 : fading;
+}
+
+// What the light found by a bounce is worth before it, see Ray::getAttenuation(); the glossy
+// share is taken of the attenuated light
+static Rgb bounceWeight(int attenuation, float fading, float shining) {
+	Rgb weight(Rgb(1, 1, 1).attenuate(attenuation, fading));
+	if (shining > +0)
+		weight += Rgb(weight).attenuate(-1, shining);
+	return weight;
+}
+
+// 'r' is the bounce of the hit 'rec'. In PATH mode planar lights light it by next-event
+// estimation, the point-like ones as in RAY mode.
+void Camera::lightings(Ray& ray, HitRecord& rec, int r) {
 	if (fakeAmbientLightOn && tracingType == RAY) ray.fakeAmbientLighting(rec, ambient.light);
-	if (directLightOn) ray.directLightings(rec, scenerys, lightsIdx);
-	if (photonMap != NO) ray.phMapLightings(rec, phMap, photonMap);
+	if (directLightOn && tracingType == PATH) {
+		areaLightings(ray, rec, r);
+		ray.directLightings(rec, snapshot->scenerys, snapshot->pointLights, shadowRays);
+	} else if (directLightOn) {
+		ray.directLightings(rec, snapshot->scenerys, snapshot->directLights, shadowRays);
+	}
+	if (photonMap != NO) ray.phMapLightings(rec, snapshot->phMap, photonMap, photonSearch);
+}
+
+// Next-event estimation of the light the planar lights give the diffuse share of the hit
+// 'rec': shadow rays to random points of their surfaces, as many as to the point-like lights.
+// The estimate weighs as a diffuse bounce of a light path would (see ambientLightPath()), so
+// the two are combined by the power heuristic; past 'depth' no bounce could find the light.
+void Camera::areaLightings(Ray& ray, HitRecord& rec, int r) {
+	const LightPicker& lights = snapshot->areaLights;
+	if (!rec.scnr->diffusion || rec.hit == IN_VOLUME || lights.empty())
+		return;
+	if (!lights.isPicking(shadowRays)) {
+		for (auto light = lights.begin(), end = lights.end(); light != end; ++light)
+			areaLighting(ray, rec, **light, r);
+	} else {
+		for (int i = 0; i < shadowRays; i++)
+			areaLighting(ray, rec, *lights[lights.sample(random_double())], r);
+	}
+}
+
+void Camera::areaLighting(Ray& ray, HitRecord& rec, const Light& light, int r) {
+	Vec3f point = light.get_planar()->getRandomPoint();
+	ray.dist = ray.dir.substract(point, ray.pov).norm();
+	ray.dir.product(1. / ray.dist);
+	float cosine = ray.dir * rec.norm;
+	float lightPdf = snapshot->areaLights.picks(&light, shadowRays) * light.surfacePdf(ray.dir, ray.dist);
+	if (cosine > 0 && lightPdf > 0) {
+		ray.movePovByNormal(EPSILON);
+		if (!ray.closestScenery(snapshot->scenerys, ray.dist - 2 * EPSILON, ANY_SHADOW)) {
+			float fading = pathFading(), shining = 0;
+			int attenuation = ray.getAttenuation(rec, DIFFUSION, fading, shining);
+			float bsdfPdf = rec.scnr->diffusion * cosine * M_1_PI;
+			float mis = r < depth ? powerHeuristic(lightPdf, bsdfPdf) : 1;
+			Rgb nee(bounceWeight(attenuation, fading, shining));
+			nee *= light.glowing(light.get_planar()->localHitPoint(point));
+			rec.paint += nee *= (bsdfPdf / lightPdf * mis);
+		}
+	}
+	ray.restore(rec);
 }
 
 void Camera::ambientLightPathsTarcing(Ray& ray, HitRecord& rec, int r) {
 	MeanRgb mean;
-	for (int i = 0; i < paths; i++) {
+	for (int i = 0; i < PATHS_PER_PASS; i++) {
 		ambientLightPath(ray, rec, r);
 		mean += ray.paint;
 		ray.restore(rec);
 	}
-	rec.paint = mean;
+	rec.paint = mean.get_mean();
 }
 
-void Camera::tracePath(Ray& ray, int r) {
-	if (!ray.end(scenerys, background, depth, r)){
-		HitRecord rec(ray.getNormal());
-		lightings(ray, rec);
-		ambientLightPath(ray, rec, r);
-		ray.paint += rec.paint;
-	}
+// Largest band of a path weight
+static float maxBand(const Rgb& weight) {
+	return std::max(weight.get_band(0), std::max(weight.get_band(1), weight.get_band(2)));
 }
 
+// Power heuristic weight of the light a diffuse bounce from 'from' finds on a planar light,
+// the counterpart of the next-event estimation in areaLightings()
+float Camera::glowingWeight(const Ray& ray, const HitRecord& from) const {
+	if (!directLightOn || ray.recursion > depth || !ray.scnr || !ray.scnr->get_isLight())
+		return 1;
+	const Light* light = static_cast<const Light*>(ray.scnr);
+	float bsdfPdf = from.scnr->diffusion * (ray.dir * from.norm) * M_1_PI;
+	float lightPdf = snapshot->areaLights.picks(light, shadowRays) * light->surfacePdf(ray.dir, ray.dist);
+	return powerHeuristic(bsdfPdf, lightPdf);
+}
+
+// One light path from the hit 'rec', bounce by bounce: 'weight' is what the light found at
+// the next bounce is worth at 'rec'. Past RR_MIN_BOUNCES a dim path is ended by Russian
+// roulette, and a surviving one is weighted up by 1 / survival, so the mean stays the same;
+// 'depth' only caps the rest. If a path that was fully reflected inside a body runs out of
+// depth, the body shows the background from that bounce on.
 void Camera::ambientLightPath(Ray& ray, HitRecord& rec, int r) {
-	float fading = fakeAmbientLightOn ? ambient.get_ratio() : 1, shining = 0;
-	fading = fading == 0 ? 1 : fading;
-	Probability p;
-	rec.scnr->get_probability(p);
-	Choice choice = ray.chooseDirection(rec, p);
-	int	attenuation = ray.getAttenuation(rec, choice, fading, shining);
-	tracePath(ray, ++r);
-	if (choice == FULL_REFLECTION && ray.recursion > depth)
-		ray.paint = background.light;
-	if (shining > +0)
-		ray.paint = (Rgb(ray.paint).attenuate(-1, shining)) += ray.paint.attenuate(attenuation, fading);
-	else
-		ray.paint.attenuate(attenuation, fading);
+	HitRecord	hit(rec);
+	Rgb			light, weight(1, 1, 1), fullLight, fullWeight;
+	bool		full = false;
+	for (;; r++) {
+		float fading = pathFading(), shining = 0;
+		Probability p;
+		hit.scnr->get_probability(p);
+		Choice choice = ray.chooseDirection(hit, p);
+		int	attenuation = ray.getAttenuation(hit, choice, fading, shining);
+		weight *= bounceWeight(attenuation, fading, shining);
+		float survival = r < RR_MIN_BOUNCES ? 1 : std::min(maxBand(weight), RR_MAX_SURVIVAL);
+		if (maxBand(weight) <= 0 || (survival < 1 && random_double() >= survival))
+			break;
+		if (survival < 1)
+			weight *= 1 / survival;
+		if (choice == FULL_REFLECTION && !full) {
+			full = true;
+			fullLight = light;
+			fullWeight = weight;
+		}
+		if (ray.end(snapshot->scenerys, background, depth, r + 1)) {
+			if (full && ray.recursion > depth)
+				light = fullLight += (fullWeight *= background.light);
+			else if (choice == DIFFUSION)
+				light += (ray.paint *= glowingWeight(ray, hit)) *= weight;
+			else
+				light += ray.paint *= weight;
+			break;
+		}
+		hit = HitRecord(ray.getNormal());
+		lightings(ray, hit, r + 1);
+		light += hit.paint *= weight;
+	}
+	ray.paint = light;
 }
 
 void Camera::calculateFlybyRadius(void) {
 	float	back = 0;
 	float	front = _INFINITY;
-	for (auto pixel = matrix.begin(), END = matrix.end(); pixel != END; ++pixel) {
-		pixel->restoreRays(1, _fov.get_tan(), _pos.p);
-		auto ray = pixel->rays.begin();
-		for (auto sc = scenerys.begin(), end = scenerys.end(); sc != end; ++sc) {
-			ray->hit = FRONT;
-			if ( (*sc)->intersection(*ray) ) {
-				if (front > ray->dist) {
-					front = ray->dist;
+	Ray		ray;
+	for (size_t idx = 0, size = matrix.size(); idx < size; idx++) {
+		primaryRay(idx, 0, ray);
+		for (auto sc = snapshot->scenerys.begin(), end = snapshot->scenerys.end(); sc != end; ++sc) {
+			ray.hit = FRONT;
+			if ( (*sc)->intersection(ray) ) {
+				if (front > ray.dist) {
+					front = ray.dist;
 				}
 			}
-			ray->hit = BACK;
-			if ( (*sc)->intersection(*ray) ) {
-				if (back < ray->dist && ray->dist < _INFINITY) {
-					back = ray->dist;
+			ray.hit = BACK;
+			if ( (*sc)->intersection(ray) ) {
+				if (back < ray.dist && ray.dist < _INFINITY) {
+					back = ray.dist;
 				}
 			}
 		}
@@ -515,40 +750,36 @@ void Camera::calculateFlybyRadius(void) {
 }
 
 void Camera::runThreadRoutine(int routine, MlxImage* img) {
-	size_t size = this->matrix.size();
-	size_t begin, end;
-	int numThreads = (int)(size / PIXELS_PER_THREAD);
-	if (size % PIXELS_PER_THREAD > 0) {
-		numThreads++;
-	}
-	std::thread th[numThreads];
-	for (int i = 0; i < numThreads; i++) {
-		begin = i * size / numThreads;
-		if (i == numThreads - 1) {
-			end = size;
-		} else {
-			end = size / numThreads * (i + 1);
-		}
-		switch (routine) {
-			case RESTORE_RAYS:
-				th[i] = std::thread([this, begin, end](){restoreRays(this, begin, end);});
-				break ;
-			case RESET_RAYS:
-				th[i] = std::thread([this, begin, end](){resetRays(this, begin, end);});
-				break ;
-			case TAKE_PICTURE:
-				if (img != NULL) {
-					th[i] = std::thread([this, img, begin, end](){takePicture(this, *img, begin, end);});
-				}
-				break ;
-			case RAYS_TRACING:
-				th[i] = std::thread([this, begin, end](){raysTracing(this, begin, end);});
-				break ;
+	ThreadPool& pool = ThreadPool::get();
+	switch (routine) {
+		case RESTORE_RAYS:
+			pool.run(matrix.size(), PIXELS_PER_TILE, [this](size_t begin, size_t end){restoreRays(this, begin, end);});
+			_passes = 0;
+			break ;
+		case RESET_RAYS:
+			pool.run(matrix.size(), PIXELS_PER_TILE, [this](size_t begin, size_t end){resetRays(this, begin, end);});
+			_passes = 0;
+			break ;
+		case TAKE_PICTURE:
+			if (img != NULL) {
+				pool.run(matrix.size(), PIXELS_PER_TILE, [this, img](size_t begin, size_t end){takePicture(this, *img, begin, end);});
+			}
+			break ;
+		case RAYS_TRACING: {
+			common::PassMetric pass;
+			profile_scope("render pass");
+			if (isAdaptiveAA())
+				_firstRgba.resize(matrix.size());
+			pool.run(_tiles.size(), 1, [this](size_t begin, size_t end){raysTracing(this, begin, end);});
+			if (isAdaptiveAA()) {
+				profile_scope("refine pass");
+				pool.run(_tiles.size(), 1, [this](size_t begin, size_t end){refineTracing(this, begin, end);});
+			}
+			_frame++;
+			_passes++;
+			break ;
 		}
 	}
-	for (int i = 0; i < numThreads; i++) {
-		th[i].join();
-	}
 }
 
 
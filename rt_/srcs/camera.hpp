@@ -1,9 +1,10 @@
 #ifndef CAMERA_HPP
 # define CAMERA_HPP
 
-# include <thread>
 # include "MlxImage.hpp"
+# include "ThreadPool.hpp"
 # include "Ray.hpp"
+# include "SceneSnapshot.hpp"
 
 
 class Fov {
@@ -23,16 +24,24 @@ public:
 };
 
 
+// Accumulated colour of a pixel; its primary rays are generated on the fly (Camera::primaryRay)
 struct Pixel {
-	Rays		rays;
-	Vec3f		cPos; // relative xy-coordinate on RT canvas of width 1
 	MeanRgb		paint;
-	Pixel(const Vec3f& cPos, int smoothingFactor, float tan, const Vec3f& pos);
+	int			samples;	// rays traced into 'paint'
+	Pixel(void);
 	~Pixel(void);
 	Pixel(const Pixel& other);
 	Pixel& operator=(const Pixel& other);
-	void reset(int smoothingFactor, float tan, const Vec3f& pov);
-	void restoreRays(int smoothingFactor, float tan, const Vec3f& pov);
+	void reset(void);
+};
+
+
+// Square block of pixels [x0, x1) x [y0, y1) traced as one task
+struct ImageTile {
+	int	x0;
+	int	y0;
+	int	x1;
+	int	y1;
 };
 
 	
@@ -63,17 +72,29 @@ protected:
 	Position			_base;
 	Position			_pos;
 	float				_roll;	// Camera tilt (aviation term 'roll') relative to its optical axis (z-axis)
+	Vec3f				_eye;	// world space point of view
+	LookatAux			_axes;	// world space camera axes without the roll
+	LookatAux			_view;	// world space camera axes with the roll, the primary rays basis
 	float				_flybyRadius;
+	uint64_t			_frame;	// number of RAYS_TRACING passes, keys the per-sample random sequences
+	int					_passes;	// passes accumulated in the pixels since the rays were restored
+	int					_tileSize;
+	std::vector<ImageTile>	_tiles;	// in Morton order, so neighbouring tasks trace neighbouring pixels
+	std::vector<int>		_firstRgba;	// colour of the first sample of each pixel, for adaptive AA
+	Vec3f	toWorld(const Vec3f& v) const;
+	void	updateView(void);
+	void	primaryRay(size_t idx, int sample, Ray& ray) const;
+	void	tracePixel(Pixel& pixel, size_t idx, size_t first, size_t last);
+	bool	isEdge(int x, int y) const;
 public:
-	Scenerys	scenerys;
-	Scenerys	objsIdx;
-	Scenerys	lightsIdx;
-	PhotonMap	phMap;
+	std::shared_ptr<const SceneSnapshot>	snapshot;	// shared by all cameras
 	Lighting	ambient;
 	Lighting	background;
 	int			depth;
-	int			paths;
+	int			paths;	// PATH passes, i.e. samples per pixel, the picture is refined with
+	int			shadowRays;	// to the lights of one kind per hit, see LightPicker
 	MapType		photonMap;
+	PhotonSearch	photonSearch;
 	TracingType	tracingType;
 	bool		fakeAmbientLightOn;
 	bool		directLightOn;
@@ -84,9 +105,17 @@ public:
 	Position get_pos(void) const;
 	float	get_rollDegree(void) const;
 	float	get_flybyRadius(void) const;
-	void	set_scenery(A_Scenery* scenery);
+	int		get_passes(void) const;
+	int		get_tileSize(void) const;
+	size_t	get_numTiles(void) const;
+	bool	isConverged(void) const;
+	bool	isAdaptiveAA(void) const;
+	size_t	countSamples(void) const;
+	void	set_scene(std::shared_ptr<const SceneSnapshot> snapshot);
 	void	set_posToBase(void);
 	void	initMatrix(void);
+	void	initTiles(void);
+	void	resetTileSize(int tileSize);
 	void	restoreRays_lll(size_t begin, size_t end);
 	static void restoreRays(Camera* camera, size_t begin, size_t end);
 	void	resetRays_lll(size_t begin, size_t end);
@@ -101,16 +130,22 @@ public:
 	void	lookatCamera(const Position& pos);
 	void	takePicture_lll(MlxImage& img, size_t begin, size_t end);
 	static void	takePicture(Camera* camera, MlxImage& img, size_t begin, size_t end);
+	int		savePicture(const std::string& filename) const;
 	void	raysTracing_lll(size_t begin, size_t end);
 	static void	raysTracing(Camera* camera, size_t begin, size_t end);
+	void	refineTracing_lll(size_t begin, size_t end);
+	static void	refineTracing(Camera* camera, size_t begin, size_t end);
+	int		saveHeatmap(const std::string& filename) const;
 	
 	void	tarcing(Ray& ray, int r = 0);
 	void	traceRay(Ray& ray, int r = 0);
-	void	reflections(Ray& ray, HitRecord& rec, float fading, int r);
-	void	refractions(Ray& ray, HitRecord& rec, float fading, int r);
-	void	lightings(Ray& ray, HitRecord& rec);
+	void	traceBranches(Ray& ray, HitRecord& rec, int r);
+	void	lightings(Ray& ray, HitRecord& rec, int r);
+	void	areaLightings(Ray& ray, HitRecord& rec, int r);
+	void	areaLighting(Ray& ray, HitRecord& rec, const Light& light, int r);
+	float	glowingWeight(const Ray& ray, const HitRecord& from) const;
+	float	pathFading(void) const;
 	void	ambientLightPathsTarcing(Ray& ray, HitRecord& rec, int r);
-	void	tracePath(Ray& ray, int r = 0);
 	void	ambientLightPath(Ray& ray, HitRecord& rec, int r);
 	void	calculateFlybyRadius(void);
 	void 	runThreadRoutine(int routine, MlxImage* img = NULL);
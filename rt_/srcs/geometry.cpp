@@ -21,15 +21,17 @@ float	f2limits(float num, float min, float max) {
 	return num;
 }
 
+Random&	localRandom(void) {
+	static thread_local Random random;
+	return random;
+}
+
 double	random_double(void) {
-	static std::random_device rd;
-	static std::mt19937 gen(rd());
-	static std::uniform_real_distribution<> dis(0.0, 1.0);
-	return dis(gen);
+	return localRandom().get_double();
 }
 
 double	randomUnitCoordinate(void) {
-	return (random_double() * 2.0 - 1.0);
+	return localRandom().unitCoordinate();
 }
 
 float	randomCoordinate(float n) {
@@ -87,6 +89,14 @@ float	getSchlick(float cosine, float eta) {
 	return r0 + (1 - r0) * pow((1 - cosine), 5);
 }
 
+// Multiple importance sampling weight of a sample drawn with 'pdf' that another
+// strategy could have drawn with 'otherPdf'
+float	powerHeuristic(float pdf, float otherPdf) {
+	pdf *= pdf;
+	otherPdf *= otherPdf;
+	return pdf + otherPdf > 0 ? pdf / (pdf + otherPdf) : 0;
+}
+
 long	elapsedTimeMs(const decltype(std::chrono::high_resolution_clock::now())& start, bool condition) {
 	if (condition) {
 		auto finish = std::chrono::high_resolution_clock::now();
@@ -233,6 +243,36 @@ Texture2& Texture2::operator=(const Texture2& other) {
 Texture2::~Texture2(void) {}
 
 
+// struct AliasTable
+
+void AliasTable::build(const std::vector<float>& weights) {
+	int n = (int)weights.size();
+	double total = 0;
+	for (int i = 0; i < n; i++)
+		total += weights[i];
+	keep.assign(total > 0 ? n : 0, 1);
+	alias.resize(keep.size());
+	if (keep.empty())
+		return;
+	std::vector<double> scaled(n);
+	std::vector<int> small, large;
+	for (int i = 0; i < n; i++) {
+		alias[i] = i;
+		scaled[i] = weights[i] * n / total;
+		(scaled[i] < 1 ? small : large).push_back(i);
+	}
+	while (!small.empty() && !large.empty()) {
+		int s = small.back(), l = large.back();
+		small.pop_back();
+		large.pop_back();
+		keep[s] = scaled[s];
+		alias[s] = l;
+		scaled[l] += scaled[s] - 1;
+		(scaled[l] < 1 ? small : large).push_back(l);
+	}
+}
+
+
 // struct A_Planar
 
 A_Planar::A_Planar(void) :
@@ -1,11 +1,17 @@
 #ifndef GEOMETRY_HPP
 # define GEOMETRY_HPP
 
+# include <chrono>
+# include <cstring>
 # include <iomanip>
 # include <sstream>
 //# include <functional>
-# include <random>
+# include <cmath>
+# include <algorithm>
+# include <limits>
+# include <vector>
 # include "Header.h"
+# include "Random.hpp"
 
 template <class t> struct Vec2;
 template <class t> struct Vec3;
@@ -30,6 +36,7 @@ const float CONE_FILTER_NORMALIZATION(1. - 2. / (3. * CONE_FILTER_COEFFICIENT));
 enum Hit { FRONT, BACK, OUTLINE, ANY_SHADOW, ALL_SHADOWS, INSIDE, OUTSIDE, IN_VOLUME };
 enum CombineType { END=0, UNION, SUBTRACTION, INTERSECTION };
 enum MapType {NO, CAUSTIC, GLOBAL, VOLUME, RESET};
+enum PhotonSearch { GRID_SEARCH, KDTREE_SEARCH };
 enum TracingType { RAY, PATH };
 
 
@@ -46,6 +53,7 @@ bool	rayHitDefinition(float& min_t, float& max_t, float& distance, Hit& rayHit);
 float	getShining(const Vec3f& dirFromPov, const Vec3f& normal, const Vec3f& dirToLight, float glossy);
 float	getShining_(const Vec3f& dirFromPov, const Vec3f& normal, Vec3f dirToLight, float glossy);
 float	getSchlick(float cosine, float ref_idx);
+float	powerHeuristic(float pdf, float otherPdf);
 long	elapsedTimeMs(const decltype(std::chrono::high_resolution_clock::now())& start, bool condition);
 void	displayTimeMs(long ms, std::string hint = "");
 std::string roundedString(float num, int factor = 2);
@@ -117,15 +125,9 @@ template <class t> struct Vec3 {
 	};
 	Vec3(void) : x(0), y(0), z(0) {}
 	Vec3(t _x, t _y, t _z) : x(_x),y(_y),z(_z) {}
-	Vec3(const Vec3<t>& other) : x(other.x), y(other.y), z(other.z) {}
-	~Vec3(void) {}
-	Vec3<t>& operator=(const Vec3<t>& other) {
-		if (this != &other) {
-			for (int i = 0; i < 3; i++)
-				raw[i] = other.raw[i];
-		}
-		return *this;
-	}
+	Vec3(const Vec3<t>& other) = default;
+	~Vec3(void) = default;
+	Vec3<t>& operator=(const Vec3<t>& other) = default;
 	Vec3<t>& set_xyz(t _x, t _y, t _z) { x = _x; y = _y; z = _z; return *this; }
 	Vec3<t>& product(const Vec3<t>& v1, const Vec3<t>& v2) {
 		t _x = v1.y * v2.z - v1.z * v2.y;
@@ -161,7 +163,7 @@ template <class t> struct Vec3 {
 	inline Vec3<t>	operator+(const Vec3<t>& v) const { return Vec3<t>().addition(*this, v); }
 	inline Vec3<t>	operator-(const Vec3<t>& v) const { return Vec3<t>().substract(*this, v); }
 	inline Vec3<t>	operator*(float f) const { return Vec3<t>(*this).product(f); }
-	inline t		operator*(const Vec3<t>& v) const { return Vec3<t>(*this).product(v);}
+	inline t		operator*(const Vec3<t>& v) const { return x * v.x + y * v.y + z * v.z; }
 	inline bool refract(Vec3<t>& normal, float eta) {
 //		float eta = 1. / matIOR; // eta = in_IOR/out_IOR
 		float cos_theta = -(*this * normal);
@@ -210,31 +212,31 @@ template <class t> struct Vec3 {
 		x = _x; y = _y; z = _z;
 		return *this;
 	}
-	Vec3<t>& randomInUnitSphere(void) {
+	Vec3<t>& randomInUnitSphere(Random& random = localRandom()) {
 		do {
-			x = randomUnitCoordinate();
-			y = randomUnitCoordinate();
-			z = randomUnitCoordinate();
+			x = random.unitCoordinate();
+			y = random.unitCoordinate();
+			z = random.unitCoordinate();
 		} while (sqnorm() >= 1.0f);
 		normalize();
 		return *this;
 	}
-	Vec3<t>& randomInUnitHemisphere(const Vec3<t>& normal) {
-		addition(randomInUnitSphere(), normal).normalize();
+	Vec3<t>& randomInUnitHemisphere(const Vec3<t>& normal, Random& random = localRandom()) {
+		addition(randomInUnitSphere(random), normal).normalize();
 		return *this;
 	}
-	Vec3<t>& randomInUnitHemisphereCosineDistribution(const LookatAux& aux) {
-		float phi = random_double() * M_2PI;
-		float theta = std::acos(std::sqrt(random_double()));
+	Vec3<t>& randomInUnitHemisphereCosineDistribution(const LookatAux& aux, Random& random = localRandom()) {
+		float phi = random.get_double() * M_2PI;
+		float theta = std::acos(std::sqrt(random.get_double()));
 		spherical2cartesian(phi, theta).lookatDir(aux);
 		return *this;
 	}
-	Vec3<t>& randomInUnitHemisphereCosineDistribution(const Vec3f& normal) {
+	Vec3<t>& randomInUnitHemisphereCosineDistribution(const Vec3f& normal, Random& random = localRandom()) {
 		LookatAuxiliary<t> aux(normal);
-		return randomInUnitHemisphereCosineDistribution(aux);
+		return randomInUnitHemisphereCosineDistribution(aux, random);
 	}
-	Vec3<t>& randomInSphere(t r) {
-		randomInUnitSphere().product(r);
+	Vec3<t>& randomInSphere(t r, Random& random = localRandom()) {
+		randomInUnitSphere(random).product(r);
 		return *this;
 	}
 	Vec3<t>& toRt(int width, int height) { x -= width / 2; y = height / 2 - y - 1; return *this; }
@@ -318,6 +320,7 @@ template <class t> struct LookatAuxiliary {
 	Vec3<t> dir;
 	Vec3<t> up;
 	Vec3<t> right;
+	LookatAuxiliary(void) : dir(0,0,1), up(0,1,0), right(1,0,0) {}
 	LookatAuxiliary(const Vec3<t>& eyeDir) : dir(eyeDir), up(), right(0,-1,0) {
 		if ( dir.x == 0 && (dir.y == -1 || dir.y == 1) && dir.z == 0) {
 			right.y = 0; right.z = 1;
@@ -368,6 +371,23 @@ struct Probability : public Vec3f {
 };
 
 
+// struct AliasTable
+// Picks an index in proportion to its weight with one random number in O(1)
+// (Walker's alias method with Vose's setup)
+struct AliasTable {
+	std::vector<float>	keep;	// chance a column keeps its own index
+	std::vector<int>	alias;	// index a column gives the rest of its chance to
+	AliasTable(void) : keep(), alias() {}
+	~AliasTable(void) {}
+	void build(const std::vector<float>& weights);
+	inline int sample(double chance) const {
+		double column = chance * keep.size();
+		int i = std::min(int(column), int(keep.size()) - 1);
+		return column - i < keep[i] ? i : alias[i];
+	}
+};
+
+
 // class Texture2
 class Texture2 : public texture2_t {
 	std::string _id;
@@ -390,6 +410,64 @@ public:
 	inline void set_width(int width) { _width = std::abs(width); _height = int(size()) / _width; }
 };
 
+// struct Aabb
+struct Aabb {
+	Vec3f	min;
+	Vec3f	max;
+	Aabb(void) :
+	min(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()),
+	max(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max())
+	{}
+	Aabb(const Vec3f& _min, const Vec3f& _max) : min(_min), max(_max) {}
+	Aabb(const Aabb& other) : min(other.min), max(other.max) {}
+	~Aabb(void) {}
+	Aabb& operator=(const Aabb& other) {
+		if (this != &other) {
+			min = other.min;
+			max = other.max;
+		}
+		return *this;
+	}
+	inline Aabb& expand(const Vec3f& p) {
+		for (int i = 0; i < 3; i++) {
+			min.raw[i] = std::min(min.raw[i], p.raw[i]);
+			max.raw[i] = std::max(max.raw[i], p.raw[i]);
+		}
+		return *this;
+	}
+	inline Aabb& expand(const Aabb& other) {
+		for (int i = 0; i < 3; i++) {
+			min.raw[i] = std::min(min.raw[i], other.min.raw[i]);
+			max.raw[i] = std::max(max.raw[i], other.max.raw[i]);
+		}
+		return *this;
+	}
+	inline Aabb& expand(const Vec3f& center, const Vec3f& extent) {
+		return expand(center - extent).expand(center + extent);
+	}
+	inline bool  isEmpty(void) const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+	inline Vec3f centroid(void) const { return (min + max) * 0.5f; }
+	inline float area(void) const {
+		if (isEmpty())
+			return 0;
+		Vec3f d = max - min;
+		return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+	inline bool  intersection(const Vec3f& pov, const Vec3f& invDir, float maxDistance, float& distance) const {
+		float tmin = 0, tmax = maxDistance;
+		for (int i = 0; i < 3; i++) {
+			float t1 = (min.raw[i] - pov.raw[i]) * invDir.raw[i];
+			float t2 = (max.raw[i] - pov.raw[i]) * invDir.raw[i];
+			tmin = std::max(tmin, std::min(t1, t2));
+			tmax = std::min(tmax, std::max(t1, t2));
+		}
+		distance = tmin;
+		return tmin <= tmax;
+	}
+};
+// struct Aabb end
+
+
 // struct A_Planar
 struct A_Planar {
 	Position	pos;	// plane position
@@ -497,6 +575,7 @@ struct A_Planar {
 	virtual inline float area(void) const = 0;
 	virtual inline bool  figureIntersection(const Vec3f& localHitPoint, Hit& hit) const = 0;
 	virtual inline float getMaxSize(void) const = 0;
+	virtual inline bool  bounds(Aabb& box) const = 0;
 	virtual inline Vec3f getRandomPoint(void) const = 0;
 	virtual inline int   getTextureRgba(const Vec3f& localHitPoint) const = 0;
 	virtual inline std::string output_geometry(void) const = 0;
@@ -517,6 +596,10 @@ struct Plane : public A_Planar {
 		return true;
 	}
 	inline float getMaxSize(void) const { return _INFINITY; }
+	inline bool  bounds(Aabb& box) const {
+		(void)box;
+		return false;
+	}
 	inline Vec3f getRandomPoint(void) const {
 		return pos.p + (u * randomCoordinate(_INFINITY)) + (v * randomCoordinate(_INFINITY));
 	}
@@ -556,6 +639,13 @@ struct Circle : public A_Planar {
 		return false;
 	}
 	inline float getMaxSize(void) const { return r * 2; }
+	inline bool  bounds(Aabb& box) const {
+		Vec3f extent;
+		for (int i = 0; i < 3; i++)
+			extent.raw[i] = r * std::sqrt(std::max(0.0f, 1.0f - pos.n.raw[i] * pos.n.raw[i]));
+		box.expand(pos.p, extent);
+		return true;
+	}
 	inline Vec3f getRandomPoint(void) const {
 		Vec3f point;
 		do {
@@ -603,11 +693,18 @@ struct Rectangle : public A_Planar {
 		if (d_u >= 0 && d_v >= 0) {
 			if ( std::abs(d_u) <= OUTLINE_WIDTH && std::abs(d_v) <= OUTLINE_WIDTH )
 				hit = OUTLINE;
-				return true;
+			return true;
 		}
 		return d_u >= 0 && d_v >= 0;
 	}
 	inline float getMaxSize(void) const { return 2.0f * std::sqrt(w_2 * w_2 + h_2 * h_2); }
+	inline bool  bounds(Aabb& box) const {
+		Vec3f extent;
+		for (int i = 0; i < 3; i++)
+			extent.raw[i] = std::abs(u.raw[i]) * w_2 + std::abs(v.raw[i]) * h_2;
+		box.expand(pos.p, extent);
+		return true;
+	}
 	inline Vec3f getRandomPoint(void) const {
 		return pos.p + (u * randomCoordinate(w_2)) + (v * randomCoordinate(h_2));
 	}
@@ -41,6 +41,7 @@ enum {
 	KEY_C				= 8,
 	KEY_D				= 2,
 	KEY_G				= 5,
+	KEY_K				= 40,
 	KEY_N				= 45,
 	KEY_P				= 35,
 	KEY_R				= 15,
@@ -13,7 +13,7 @@ enum {
 	KEY_LEFT_CMD		= 65515,
 	KEY_RIGHT_CMD		= 65516,
 	KEY_LEFT_CTRL		= 65507,
-	KEY_RIGHT_CTRL		= 269, // find
+	KEY_RIGHT_CTRL		= 65508,
 	KEY_LEFT_SHIFT		= 65505,
 	KEY_RIGHT_SHIFT		= 65506,
 	KEY_LEFT_ALT		= 65513,
@@ -36,7 +36,18 @@ enum {
 	KEY_0				= 48,
 	KEY_MINUS			= 45,
 	KEY_PLUS			= 61,
+	KEY_A				= 97,
+	KEY_B				= 98,
+	KEY_C				= 99,
+	KEY_D				= 100,
 	KEY_F				= 102,
+	KEY_G				= 103,
+	KEY_K				= 107,
+	KEY_N				= 110,
+	KEY_P				= 112,
+	KEY_R				= 114,
+	KEY_S				= 115,
+	KEY_V				= 118,
 	MOUSE_LEFT_CLICK	= 1,
 	MOUSE_RIGHT_CLICK	= 3,
 	MOUSE_MIDDLE_CLICK	= 2, // maybe won't work
@@ -1,20 +1,38 @@
 #include "MlxImage.hpp"
+#include "Metrics.hpp"
 
 Var	var;
 
 int main(int ac, char** av) {
 	MlxImage	img;
 	Scene		scene(img);
+	Options		options;
 	var.img		= &img;
 	var.scene	= &scene;
-	system("clear");
+	var.options	= &options;
+	if (parseOptions(ac, av, options))
+		return ERROR;
+	options.headless = options.headless || img.get_headless();
+	img.set_headless(options.headless);
+	if (!options.headless)
+		system("clear");
 	scene.mesage(WELLCOM_MSG);
-	outputFile(CONTROLS_FILE);
+	if (!options.headless)
+		outputFile(CONTROLS_FILE);
 	if (scene.parsing(ac, av))
 		return ERROR;
+	scene.set_options(options);
+	if (options.headless) {
+		int ret = scene.renderPicture(options.output, options.samples, options.heatmap);
+		if (outputMetrics(options.metricsDump, options.metricsFile) != SUCCESS)
+			ret = ERROR;
+		return outputProfile(options.profileFile) == SUCCESS ? ret : ERROR;
+	}
+# ifndef RT_HEADLESS
 	void* mlx = img.get_mlx();
 	scene.rt();
 	mlx_loop_hook(mlx, flyby, NULL);
 	mlx_loop(mlx);
+# endif
 	return SUCCESS;
 }
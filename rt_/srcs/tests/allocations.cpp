@@ -0,0 +1,70 @@
+//
+//  allocations.cpp
+//  tests
+//
+//  Counts the heap allocations made by Ray::closestScenery in steady state:
+//  camera, shadow and all-shadows rays through CSG combinations and plain spheres.
+//  From srcs/:
+//  g++ -std=c++2a -O2 -I. tests/allocations.cpp A_Scenery.cpp ARGBColor.cpp Bvh.cpp geometry.cpp \
+//      KdTree.cpp PhotonMap.cpp Ray.cpp Rgb.cpp Sphere.cpp ThreadPool.cpp -lpthread -o allocations
+//
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include "../Sphere.hpp"
+
+static std::atomic<long> allocations(0);
+
+void* operator new(size_t size) {
+	allocations++;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t size) noexcept { (void)size; std::free(p); }
+
+static void addSphere(Scenerys& scenerys, const std::string& str, CombineType combineType) {
+	std::istringstream is(str);
+	Sphere* sp = new Sphere;
+	is >> *sp;
+	sp->combineType = combineType;
+	scenerys.push_back(sp);
+}
+
+int main(void) {
+	Scenerys scenerys;
+	addSphere(scenerys, "-3,0,20   8    255,0,0",     INTERSECTION);	// lens with a hole
+	addSphere(scenerys, "3,0,20    8    255,0,0",     SUBTRACTION);
+	addSphere(scenerys, "0,0,18    2    255,0,0",     END);
+	addSphere(scenerys, "0,4,24    3    0,255,0",     UNION);		// chain of three
+	addSphere(scenerys, "1,4,24    3    0,255,0",     UNION);
+	addSphere(scenerys, "2,4,24    3    0,255,0",     END);
+	for (int i = 0; i < 16; i++)
+		addSphere(scenerys, std::to_string(i - 8) + ",-4,22 1.5 0,0,255", END);
+	scenerys.update();
+
+	const int	warmup = 1000, rays = 100000, side = 100;
+	const Hit	targets[] = { FRONT, ANY_SHADOW, ALL_SHADOWS };
+	Ray			ray;
+	long		hits = 0;
+	bool		failed = false;
+	for (int t = 0; t < 3; t++) {
+		for (int i = 0; i < warmup + rays; i++) {
+			if (i == warmup)
+				allocations = 0;
+			ray.recursion = 1;
+			ray.pov = Vec3f();
+			ray.dir = Vec3f((i % side - side / 2) * 0.004f, (i / side % side - side / 2) * 0.004f, 1).normalize();
+			hits += ray.closestScenery(scenerys, _INFINITY, targets[t]);
+		}
+		std::cout << (t == 0 ? "FRONT" : (t == 1 ? "ANY_SHADOW" : "ALL_SHADOWS"))
+				  << ": " << rays << " rays, " << allocations << " allocations" << std::endl;
+		failed = failed || allocations;
+	}
+	std::cout << "hits: " << hits << std::endl;
+	return failed;
+}
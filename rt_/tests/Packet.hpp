@@ -0,0 +1,203 @@
+#ifndef PACKET_HPP
+# define PACKET_HPP
+
+# include <vector>
+# include "geometry.hpp"
+
+# if defined(PACKET_SCALAR)
+#  define PACKET_LANES		1
+# elif defined(__AVX2__)
+#  include <immintrin.h>
+#  define PACKET_LANES		8		// floats per SIMD register
+# elif defined(__SSE2__)
+#  include <emmintrin.h>
+#  define PACKET_LANES		4
+# else
+#  define PACKET_LANES		1
+# endif
+# define PACKET_SIZE		8		// rays per packet, a multiple of PACKET_LANES
+
+// Kept out of srcs/ with their benchmark (tests/packets.cpp) until the renderer
+// uses them: Ray::closestScenery still traces every ray alone, and covers what
+// these kernels do not, every scenery type, the BVH, combined objects and rays
+// starting inside an object.
+
+
+// struct Lanes
+// The few float operations the packet kernels need, on one SIMD register.
+# if PACKET_LANES == 8
+struct Lanes {
+	__m256	v;
+	Lanes(void) : v(_mm256_setzero_ps()) {}
+	Lanes(__m256 v) : v(v) {}
+	Lanes(float f) : v(_mm256_set1_ps(f)) {}
+	static inline Lanes load(const float* p) { return _mm256_load_ps(p); }
+	inline void store(float* p) const { _mm256_store_ps(p, v); }
+	friend inline Lanes operator+(Lanes a, Lanes b) { return _mm256_add_ps(a.v, b.v); }
+	friend inline Lanes operator-(Lanes a, Lanes b) { return _mm256_sub_ps(a.v, b.v); }
+	friend inline Lanes operator*(Lanes a, Lanes b) { return _mm256_mul_ps(a.v, b.v); }
+	friend inline Lanes operator/(Lanes a, Lanes b) { return _mm256_div_ps(a.v, b.v); }
+	friend inline Lanes operator&(Lanes a, Lanes b) { return _mm256_and_ps(a.v, b.v); }
+	friend inline Lanes operator|(Lanes a, Lanes b) { return _mm256_or_ps(a.v, b.v); }
+	friend inline Lanes operator<(Lanes a, Lanes b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+	friend inline Lanes operator>(Lanes a, Lanes b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+	friend inline Lanes operator>=(Lanes a, Lanes b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+	friend inline Lanes min(Lanes a, Lanes b) { return _mm256_min_ps(a.v, b.v); }
+	friend inline Lanes max(Lanes a, Lanes b) { return _mm256_max_ps(a.v, b.v); }
+	friend inline Lanes sqrt(Lanes a) { return _mm256_sqrt_ps(a.v); }
+	friend inline Lanes select(Lanes mask, Lanes a, Lanes b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+	friend inline bool  any(Lanes mask) { return _mm256_movemask_ps(mask.v) != 0; }
+};
+# elif PACKET_LANES == 4
+struct Lanes {
+	__m128	v;
+	Lanes(void) : v(_mm_setzero_ps()) {}
+	Lanes(__m128 v) : v(v) {}
+	Lanes(float f) : v(_mm_set1_ps(f)) {}
+	static inline Lanes load(const float* p) { return _mm_load_ps(p); }
+	inline void store(float* p) const { _mm_store_ps(p, v); }
+	friend inline Lanes operator+(Lanes a, Lanes b) { return _mm_add_ps(a.v, b.v); }
+	friend inline Lanes operator-(Lanes a, Lanes b) { return _mm_sub_ps(a.v, b.v); }
+	friend inline Lanes operator*(Lanes a, Lanes b) { return _mm_mul_ps(a.v, b.v); }
+	friend inline Lanes operator/(Lanes a, Lanes b) { return _mm_div_ps(a.v, b.v); }
+	friend inline Lanes operator&(Lanes a, Lanes b) { return _mm_and_ps(a.v, b.v); }
+	friend inline Lanes operator|(Lanes a, Lanes b) { return _mm_or_ps(a.v, b.v); }
+	friend inline Lanes operator<(Lanes a, Lanes b) { return _mm_cmplt_ps(a.v, b.v); }
+	friend inline Lanes operator>(Lanes a, Lanes b) { return _mm_cmpgt_ps(a.v, b.v); }
+	friend inline Lanes operator>=(Lanes a, Lanes b) { return _mm_cmpge_ps(a.v, b.v); }
+	friend inline Lanes min(Lanes a, Lanes b) { return _mm_min_ps(a.v, b.v); }
+	friend inline Lanes max(Lanes a, Lanes b) { return _mm_max_ps(a.v, b.v); }
+	friend inline Lanes sqrt(Lanes a) { return _mm_sqrt_ps(a.v); }
+	friend inline Lanes select(Lanes mask, Lanes a, Lanes b) {
+		return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+	}
+	friend inline bool  any(Lanes mask) { return _mm_movemask_ps(mask.v) != 0; }
+};
+# else
+struct Lanes {	// scalar fallback, masks are 0 or 1
+	float	v;
+	Lanes(void) : v(0) {}
+	Lanes(float f) : v(f) {}
+	static inline Lanes load(const float* p) { return *p; }
+	inline void store(float* p) const { *p = v; }
+	friend inline Lanes operator+(Lanes a, Lanes b) { return a.v + b.v; }
+	friend inline Lanes operator-(Lanes a, Lanes b) { return a.v - b.v; }
+	friend inline Lanes operator*(Lanes a, Lanes b) { return a.v * b.v; }
+	friend inline Lanes operator/(Lanes a, Lanes b) { return a.v / b.v; }
+	friend inline Lanes operator&(Lanes a, Lanes b) { return float(a.v && b.v); }
+	friend inline Lanes operator|(Lanes a, Lanes b) { return float(a.v || b.v); }
+	friend inline Lanes operator<(Lanes a, Lanes b) { return float(a.v < b.v); }
+	friend inline Lanes operator>(Lanes a, Lanes b) { return float(a.v > b.v); }
+	friend inline Lanes operator>=(Lanes a, Lanes b) { return float(a.v >= b.v); }
+	friend inline Lanes min(Lanes a, Lanes b) { return b.v < a.v ? b.v : a.v; }
+	friend inline Lanes max(Lanes a, Lanes b) { return a.v < b.v ? b.v : a.v; }
+	friend inline Lanes sqrt(Lanes a) { return std::sqrt(a.v); }
+	friend inline Lanes select(Lanes mask, Lanes a, Lanes b) { return mask.v ? a : b; }
+	friend inline bool  any(Lanes mask) { return mask.v != 0; }
+};
+# endif
+// struct Lanes end
+
+
+// struct RayPacket
+// PACKET_SIZE coherent rays in SoA layout. The kernels keep, per ray, the nearest
+// distance below 't' and the index of the primitive hit there (-1: none).
+struct RayPacket {
+	alignas(32) float	px[PACKET_SIZE];
+	alignas(32) float	py[PACKET_SIZE];
+	alignas(32) float	pz[PACKET_SIZE];
+	alignas(32) float	dx[PACKET_SIZE];
+	alignas(32) float	dy[PACKET_SIZE];
+	alignas(32) float	dz[PACKET_SIZE];
+	alignas(32) float	t[PACKET_SIZE];
+	alignas(32) float	hit[PACKET_SIZE];	// primitive index, as float to stay in SIMD registers
+	inline void set(int lane, const Vec3f& pov, const Vec3f& dir, float maxDistance) {
+		px[lane] = pov.x; py[lane] = pov.y; pz[lane] = pov.z;
+		dx[lane] = dir.x; dy[lane] = dir.y; dz[lane] = dir.z;
+		t[lane] = maxDistance;
+		hit[lane] = -1;
+	}
+	inline int get_hit(int lane) const { return (int)hit[lane]; }
+};
+// struct RayPacket end
+
+
+// struct PacketSpheres
+struct PacketSpheres {
+	std::vector<float>	cx, cy, cz, sqR;
+	inline void push_back(const Vec3f& center, float sqrRadius) {
+		cx.push_back(center.x); cy.push_back(center.y); cz.push_back(center.z);
+		sqR.push_back(sqrRadius);
+	}
+	inline int size(void) const { return (int)cx.size(); }
+};
+// struct PacketSpheres end
+
+
+// struct PacketPlanes
+struct PacketPlanes {
+	std::vector<float>	nx, ny, nz, np;	// normal and normal * point
+	inline void push_back(const Vec3f& point, const Vec3f& normal) {
+		nx.push_back(normal.x); ny.push_back(normal.y); nz.push_back(normal.z);
+		np.push_back(normal * point);
+	}
+	inline int size(void) const { return (int)nx.size(); }
+};
+// struct PacketPlanes end
+
+
+// Non member functions
+// Both kernels give, lane by lane, the distances of raySphereIntersection and
+// A_Planar::intersection of an infinite plane for a FRONT ray, and like
+// Ray::closestScenery keep the first primitive on a tie.
+
+inline void packetIntersection(RayPacket& packet, const PacketSpheres& spheres, int first = 0) {
+	for (int o = 0; o < PACKET_SIZE; o += PACKET_LANES) {
+		Lanes	px = Lanes::load(packet.px + o), py = Lanes::load(packet.py + o), pz = Lanes::load(packet.pz + o);
+		Lanes	dx = Lanes::load(packet.dx + o), dy = Lanes::load(packet.dy + o), dz = Lanes::load(packet.dz + o);
+		Lanes	t = Lanes::load(packet.t + o), hit = Lanes::load(packet.hit + o), zero(0.0f);
+		for (int i = 0, size = spheres.size(); i < size; i++) {
+			Lanes kx = px - spheres.cx[i], ky = py - spheres.cy[i], kz = pz - spheres.cz[i];
+			Lanes c = kx * kx + ky * ky + kz * kz - spheres.sqR[i];
+			Lanes b = dx * kx + dy * ky + dz * kz;
+			Lanes d = b * b - c;
+			Lanes sqrtD = sqrt(max(d, zero));
+			Lanes t1 = (zero - b) + sqrtD, t2 = (zero - b) - sqrtD;
+			Lanes minT = min(t1, t2), maxT = max(t1, t2);
+			Lanes front = minT >= zero;
+			Lanes dist = select(front, minT, maxT);
+			Lanes closer = (d >= zero) & (front | (maxT > zero)) & (dist < t);
+			if (any(closer)) {
+				t = select(closer, dist, t);
+				hit = select(closer, Lanes(float(first + i)), hit);
+			}
+		}
+		t.store(packet.t + o);
+		hit.store(packet.hit + o);
+	}
+}
+
+inline void packetIntersection(RayPacket& packet, const PacketPlanes& planes, int first = 0) {
+	for (int o = 0; o < PACKET_SIZE; o += PACKET_LANES) {
+		Lanes	px = Lanes::load(packet.px + o), py = Lanes::load(packet.py + o), pz = Lanes::load(packet.pz + o);
+		Lanes	dx = Lanes::load(packet.dx + o), dy = Lanes::load(packet.dy + o), dz = Lanes::load(packet.dz + o);
+		Lanes	t = Lanes::load(packet.t + o), hit = Lanes::load(packet.hit + o), zero(0.0f), far(_2INFINITY);
+		for (int i = 0, size = planes.size(); i < size; i++) {
+			Lanes nx(planes.nx[i]), ny(planes.ny[i]), nz(planes.nz[i]);
+			Lanes normCos = dx * nx + dy * ny + dz * nz;
+			Lanes dist = (Lanes(planes.np[i]) - (nx * px + ny * py + nz * pz)) / normCos;
+			Lanes facing = normCos < zero;	// enters the half-space: behind the plane the ray is inside up to 2 * _INFINITY
+			dist = select(facing & (dist < zero), far, dist);
+			Lanes closer = (facing | ((normCos > zero) & (dist > zero))) & (dist < t);
+			if (any(closer)) {
+				t = select(closer, dist, t);
+				hit = select(closer, Lanes(float(first + i)), hit);
+			}
+		}
+		t.store(packet.t + o);
+		hit.store(packet.hit + o);
+	}
+}
+
+
+#endif /* PACKET_HPP */
@@ -0,0 +1,103 @@
+//
+//  packets.cpp
+//  tests
+//
+//  Checks the packet kernels of Packet.hpp against raySphereIntersection and
+//  Plane::intersection ray by ray, then compares their rays per second.
+//  From the project root (add -mavx2 for 8 lanes, -DPACKET_SCALAR for the scalar fallback):
+//  g++ -std=c++2a -O2 -Isrcs tests/packets.cpp srcs/geometry.cpp -o packets
+//
+
+#include <chrono>
+#include "Packet.hpp"
+
+static float scalarTrace(const Vec3f& dir, const std::vector<Vec3f>& centers, float sqrRadius,
+						 const std::vector<Plane>& planes, int& hit) {
+	float closest = _INFINITY, distance, min_t, max_t;
+	hit = -1;
+	for (int i = 0, size = (int)centers.size(); i < size; i++) {
+		Hit rayHit = FRONT;
+		if (raySphereIntersection(dir, Vec3f(), centers[i], sqrRadius, distance, min_t, max_t, rayHit) &&
+			distance < closest) {
+			closest = distance;
+			hit = i;
+		}
+	}
+	for (int i = 0, size = (int)planes.size(); i < size; i++) {
+		Hit rayHit = FRONT;
+		if (planes[i].intersection(Vec3f(), dir, distance, min_t, max_t, rayHit) && distance < closest) {
+			closest = distance;
+			hit = (int)centers.size() + i;
+		}
+	}
+	return closest;
+}
+
+static void packetTrace(RayPacket& packet, const PacketSpheres& spheres, const PacketPlanes& planes) {
+	packetIntersection(packet, spheres);
+	packetIntersection(packet, planes, spheres.size());
+}
+
+static Vec3f cameraDir(int x, int y, int side) {
+	return Vec3f((x - side / 2) * 2.0f / side, (side / 2 - y) * 2.0f / side, 1).normalize();
+}
+
+int main(void) {
+	const int			side = 512, frames = 10, grid = 6;
+	const float			sqrRadius = 1.2f * 1.2f;
+	std::vector<Vec3f>	centers;
+	std::vector<Plane>	planes(2, Plane(NULL));
+	PacketSpheres		spheres;
+	PacketPlanes		packetPlanes;
+	for (int i = 0; i < grid * grid; i++) {
+		centers.push_back(Vec3f((i % grid - grid / 2) * 3.0f, (i / grid - grid / 2) * 3.0f, 20 + (i % 3)));
+		spheres.push_back(centers.back(), sqrRadius);
+	}
+	planes[0].pos.p = Vec3f(0,-12,0); planes[0].pos.n = Vec3f(0,1,0);	// floor, seen from above
+	planes[1].pos.p = Vec3f(0,0,40); planes[1].pos.n = Vec3f(0,0,1);	// back wall, seen from behind
+	for (auto& plane : planes)
+		packetPlanes.push_back(plane.pos.p, plane.pos.n);
+
+	std::vector<float>	distances(side * side);
+	std::vector<int>	hits(side * side);
+	for (int i = 0; i < side * side; i++)
+		distances[i] = scalarTrace(cameraDir(i % side, i / side, side), centers, sqrRadius, planes, hits[i]);
+
+	long mismatches = 0;
+	RayPacket packet;
+	for (int i = 0; i < side * side; i += PACKET_SIZE) {
+		for (int lane = 0; lane < PACKET_SIZE; lane++)
+			packet.set(lane, Vec3f(), cameraDir((i + lane) % side, (i + lane) / side, side), _INFINITY);
+		packetTrace(packet, spheres, packetPlanes);
+		for (int lane = 0; lane < PACKET_SIZE; lane++)
+			if (packet.get_hit(lane) != hits[i + lane] || (hits[i + lane] >= 0 && packet.t[lane] != distances[i + lane]))
+				mismatches++;
+	}
+
+	float checksum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int f = 0; f < frames; f++)
+		for (int i = 0; i < side * side; i++) {
+			int hit;
+			checksum += scalarTrace(cameraDir(i % side, i / side, side), centers, sqrRadius, planes, hit);
+		}
+	std::chrono::duration<double> scalar = std::chrono::steady_clock::now() - start;
+	start = std::chrono::steady_clock::now();
+	for (int f = 0; f < frames; f++)
+		for (int i = 0; i < side * side; i += PACKET_SIZE) {
+			for (int lane = 0; lane < PACKET_SIZE; lane++)
+				packet.set(lane, Vec3f(), cameraDir((i + lane) % side, (i + lane) / side, side), _INFINITY);
+			packetTrace(packet, spheres, packetPlanes);
+			for (int lane = 0; lane < PACKET_SIZE; lane++)
+				checksum -= packet.t[lane];
+		}
+	std::chrono::duration<double> simd = std::chrono::steady_clock::now() - start;
+
+	double rays = double(side) * side * frames;
+	std::cout << "lanes: " << PACKET_LANES << ", packet: " << PACKET_SIZE << ", spheres: " << spheres.size()
+			  << ", planes: " << packetPlanes.size() << std::endl;
+	std::cout << "scalar: " << rays / scalar.count() / 1e6 << " Mrays/s" << std::endl;
+	std::cout << "packet: " << rays / simd.count() / 1e6 << " Mrays/s (x" << scalar.count() / simd.count() << ")" << std::endl;
+	std::cout << "mismatches: " << mismatches << ", checksum: " << checksum << std::endl;
+	return mismatches != 0;
+}